@@ -1,2 +1,6 @@
 /home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/simple_shader.vert -o shaders/simple_shader.vert.spv
-/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/simple_shader.frag -o shaders/simple_shader.frag.spv 
\ No newline at end of file
+/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/simple_shader.frag -o shaders/simple_shader.frag.spv
+/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/simple_instanced_shader.vert -o shaders/simple_instanced_shader.vert.spv
+/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/cull.comp -o shaders/cull.comp.spv
+/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/depth_pyramid.comp -o shaders/depth_pyramid.comp.spv
+/home/aigoia/vulkan/1.3.268.0/x86_64/bin/glslc shaders/depth_prepass.frag -o shaders/depth_prepass.frag.spv
@@ -3,6 +3,12 @@
 #include "keyboard_movement_controller.hpp"
 #include "lve_buffer.hpp"
 #include "lve_camera.hpp"
+#include "lve_frame_capture.hpp"
+#include "lve_frame_pipeline.hpp"
+#include "lve_model_loader.hpp"
+#include "lve_pipeline_builder.hpp"
+#include "lve_pipeline_registry.hpp"
+#include "lve_render_snapshot.hpp"
 #include "simple_render_system.hpp"
 
 // libs
@@ -15,7 +21,10 @@
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <fstream>
+#include <iostream>
 #include <stdexcept>
+#include <utility>
 
 namespace lve {
 
@@ -26,22 +35,35 @@ struct GlobalUbo {
   alignas(16) glm::vec4 lightColor{1.f};  // w is light intensity
 };
 
-FirstApp::FirstApp() {
-  globalPool =
-      LveDescriptorPool::Builder(lveDevice)
-          .setMaxSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, LveSwapChain::MAX_FRAMES_IN_FLIGHT)
-          .build();
+FirstApp::FirstApp(uint32_t headlessFrameCount, std::string capturePath)
+    : headlessFrameCount{headlessFrameCount}, capturePath{std::move(capturePath)} {
+  if (headlessFrameCount > 0) {
+    lveDevice = std::make_unique<LveDevice>();
+    lveRenderer = std::make_unique<LveRenderer>(*lveDevice, VkExtent2D{WIDTH, HEIGHT});
+  } else {
+    lveWindow = std::make_unique<LveWindow>(WIDTH, HEIGHT, "Vulkan Tutorial");
+    lveDevice = std::make_unique<LveDevice>(*lveWindow);
+    lveRenderer = std::make_unique<LveRenderer>(*lveWindow, *lveDevice);
+  }
+
+  // the app only ever changes readableDepth, so the frames in flight stay the ones configured here
+  uint32_t framesInFlight = lveRenderer->getSwapChainConfig().framesInFlight;
+  globalPool = LveDescriptorPool::Builder(*lveDevice)
+                   .setMaxSets(framesInFlight)
+                   .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight)
+                   .build();
+  geometryPool = std::make_unique<LveGeometryPool>(*lveDevice, sizeof(LveModel::Vertex));
   loadGameObjects();
 }
 
 FirstApp::~FirstApp() {}
 
 void FirstApp::run() {
-  std::vector<std::unique_ptr<LveBuffer>> uboBuffers(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  uint32_t framesInFlight = lveRenderer->getSwapChainConfig().framesInFlight;
+  std::vector<std::unique_ptr<LveBuffer>> uboBuffers(framesInFlight);
   for (int i = 0; i < uboBuffers.size(); i++) {
     uboBuffers[i] = std::make_unique<LveBuffer>(
-        lveDevice,
+        *lveDevice,
         sizeof(GlobalUbo),
         1,
         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
@@ -50,11 +72,11 @@ void FirstApp::run() {
   }
 
   auto globalSetLayout =
-      LveDescriptorSetLayout::Builder(lveDevice)
+      LveDescriptorSetLayout::Builder(*lveDevice)
           .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_ALL_GRAPHICS)
           .build();
 
-  std::vector<VkDescriptorSet> globalDescriptorSets(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+  std::vector<VkDescriptorSet> globalDescriptorSets(framesInFlight);
   for (int i = 0; i < globalDescriptorSets.size(); i++) {
     auto bufferInfo = uboBuffers[i]->descriptorInfo();
     LveDescriptorWriter(*globalSetLayout, *globalPool)
@@ -62,80 +84,199 @@ void FirstApp::run() {
         .build(globalDescriptorSets[i]);
   }
 
+  // every worker and the main thread may record a range of draws
+  lveRenderer->setRecordingThreadCount(jobSystem.getWorkerCount() + 1);
+
+  // pipeline variants compile in the background while the first frames are drawn, render systems
+  // asking for the same state share one pipeline
+  LvePipelineRegistry pipelineRegistry{*lveDevice};
+  LvePipelineBuilder pipelineBuilder{*lveDevice, &jobSystem, &pipelineRegistry};
   SimpleRenderSystem simpleRenderSystem{
-      lveDevice,
-      lveRenderer.getSwapChainRenderPass(),
-      globalSetLayout->getDescriptorSetLayout()};
+      *lveDevice,
+      lveRenderer->getSwapChainRenderPass(),
+      globalSetLayout->getDescriptorSetLayout(),
+      framesInFlight,
+      &pipelineBuilder};
+  simpleRenderSystem.setJobSystem(&jobSystem);
+  simpleRenderSystem.setParallelRecording(lveRenderer.get());
   LveCamera camera{};
 
-  auto viewerObject = LveGameObject::createGameObject();
-  viewerObject.transform.translation.z = -2.5f;
+  // written by delivery jobs, one frame at a time
+  std::ofstream captureFile{};
+  std::unique_ptr<LveFrameCapture> frameCapture{};
+  if (!capturePath.empty()) {
+    if (!lveRenderer->supportsReadback()) {
+      throw std::runtime_error("swap chain images do not support frame capture!");
+    }
+    captureFile.open(capturePath, std::ios::binary);
+    if (!captureFile) {
+      throw std::runtime_error("failed to open capture file: " + capturePath);
+    }
+    frameCapture = std::make_unique<LveFrameCapture>(
+        *lveDevice,
+        framesInFlight,
+        [&captureFile](const LveFrameCapture::Frame& frame) {
+          LveFrameCapture::writePpm(frame, captureFile);
+        },
+        &jobSystem);
+  }
+
+  TransformComponent viewerTransform{};
+  viewerTransform.translation.z = -2.5f;
   KeyboardMovementController cameraController{};
 
-  auto currentTime = std::chrono::high_resolution_clock::now();
-  while (!lveWindow.shouldClose()) {
-    glfwPollEvents();
+  // simulation, only touches the window, camera and game objects
+  auto update = [&](float frameTime, LveRenderSnapshot& snapshot) {
+    if (lveWindow) {
+      cameraController.moveInPlaneXZ(lveWindow->getGLFWwindow(), frameTime, viewerTransform);
+    }
+    camera.setViewYXZ(viewerTransform.translation, viewerTransform.rotation);
 
-    auto newTime = std::chrono::high_resolution_clock::now();
-    float frameTime =
-        std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
-    currentTime = newTime;
+    // the swap chain belongs to the render stage, so the aspect ratio comes from the window, or
+    // the fixed offscreen extent when headless
+    auto extent = lveWindow ? lveWindow->getExtent() : VkExtent2D{WIDTH, HEIGHT};
+    if (extent.width > 0 && extent.height > 0) {
+      float aspect = static_cast<float>(extent.width) / static_cast<float>(extent.height);
+      camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+    }
 
-    cameraController.moveInPlaneXZ(lveWindow.getGLFWwindow(), frameTime, viewerObject);
-    camera.setViewYXZ(viewerObject.transform.translation, viewerObject.transform.rotation);
+    gameObjects.updateMatrices(&jobSystem);
+    snapshot.capture(gameObjects, camera, frameTime);
+  };
 
-    float aspect = lveRenderer.getAspectRatio();
-    camera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 100.f);
+  // recording and submission, only reads the snapshot
+  auto render = [&](const LveRenderSnapshot& snapshot) {
+    // depth is only written back while occlusion culling reads it, changing that recreates the
+    // swap chain so it happens only when the culling mode changes
+    bool readableDepth = simpleRenderSystem.needsReadableDepth();
+    if (lveRenderer->getSwapChainConfig().readableDepth != readableDepth) {
+      auto config = lveRenderer->getSwapChainConfig();
+      config.readableDepth = readableDepth;
+      lveRenderer->setSwapChainConfig(config);
+    }
 
-    if (auto commandBuffer = lveRenderer.beginFrame()) {
-      int frameIndex = lveRenderer.getFrameIndex();
+    if (auto commandBuffer = lveRenderer->beginFrame()) {
+      int frameIndex = lveRenderer->getFrameIndex();
       FrameInfo frameInfo{
           frameIndex,
-          frameTime,
+          snapshot.getFrameTime(),
           commandBuffer,
-          camera,
+          snapshot.getCamera(),
           globalDescriptorSets[frameIndex],
-          gameObjects};
+          snapshot};
+
+      if (frameCapture) {
+        frameCapture->beginFrame(frameIndex);
+      }
 
-      // update
       GlobalUbo ubo{};
-      ubo.projectionView = camera.getProjection() * camera.getView();
+      ubo.projectionView = snapshot.getCamera().getProjection() * snapshot.getCamera().getView();
       uboBuffers[frameIndex]->writeToBuffer(&ubo);
       uboBuffers[frameIndex]->flush();
 
-      // render
-      lveRenderer.beginSwapChainRenderPass(commandBuffer);
+      simpleRenderSystem.beforeRenderPass(frameInfo, lveRenderer->getSwapChainExtent());
+      lveRenderer->beginSwapChainRenderPass(
+          commandBuffer, simpleRenderSystem.getSubpassContents());
       simpleRenderSystem.renderGameObjects(frameInfo);
-      lveRenderer.endSwapChainRenderPass(commandBuffer);
-      lveRenderer.endFrame();
+      lveRenderer->endSwapChainRenderPass(commandBuffer);
+      simpleRenderSystem.afterRenderPass(
+          frameInfo,
+          lveRenderer->hasReadableDepth() ? lveRenderer->getCurrentDepthImageView()
+                                          : VK_NULL_HANDLE);
+      if (frameCapture) {
+        frameCapture->capture(
+            commandBuffer,
+            frameIndex,
+            lveRenderer->getCurrentImage(),
+            lveRenderer->getSwapChainImageLayout(),
+            lveRenderer->getSwapChainImageFormat(),
+            lveRenderer->getSwapChainExtent());
+      }
+      lveRenderer->endFrame();
+    }
+  };
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+  auto currentTime = startTime;
+  auto nextFrameTime = [this, &currentTime]() {
+    if (headlessFrameCount > 0) {
+      // fixed time step, so every headless run renders the same frames
+      return 1.f / 60.f;
+    }
+    auto newTime = std::chrono::high_resolution_clock::now();
+    float frameTime =
+        std::chrono::duration<float, std::chrono::seconds::period>(newTime - currentTime).count();
+    currentTime = newTime;
+    return frameTime;
+  };
+
+  uint32_t frameCount = 0;
+  auto nextFrame = [this, &frameCount]() {
+    if (headlessFrameCount > 0) {
+      return frameCount++ < headlessFrameCount;
+    }
+    glfwPollEvents();
+    return !lveWindow->shouldClose();
+  };
+
+  if (PIPELINED_RENDERING) {
+    // frame N is recorded on the render thread while frame N + 1 is simulated here
+    LveFramePipeline framePipeline{render};
+    while (nextFrame()) {
+      update(nextFrameTime(), framePipeline.beginUpdate());
+      framePipeline.endUpdate();
+    }
+    framePipeline.finish();
+  } else {
+    LveRenderSnapshot snapshot{};
+    while (nextFrame()) {
+      update(nextFrameTime(), snapshot);
+      render(snapshot);
     }
   }
 
-  vkDeviceWaitIdle(lveDevice.device());
+  vkDeviceWaitIdle(lveDevice->device());
+  if (frameCapture) {
+    frameCapture->flush();
+  }
+
+  if (headlessFrameCount > 0) {
+    float totalTime = std::chrono::duration<float, std::chrono::milliseconds::period>(
+                          std::chrono::high_resolution_clock::now() - startTime)
+                          .count();
+    std::cout << "Rendered " << headlessFrameCount << " frames offscreen, "
+              << totalTime / headlessFrameCount << " ms per frame" << std::endl;
+  }
 }
 
 void FirstApp::loadGameObjects() {
-  std::shared_ptr<LveModel> lveModel =
-      LveModel::createModelFromFile(lveDevice, "models/flat_vase.obj");
+  LveModelLoader modelLoader{*lveDevice, jobSystem};
+  modelLoader.setGeometryPool(geometryPool.get());
+  auto flatVaseModel = modelLoader.loadModel("models/flat_vase.obj");
+  auto smoothVaseModel = modelLoader.loadModel("models/smooth_vase.obj");
+  auto quadModel = modelLoader.loadModel("models/quad.obj");
+  modelLoader.finishLoading();
+
   auto flatVase = LveGameObject::createGameObject();
-  flatVase.model = lveModel;
-  flatVase.transform.translation = {-.5f, .5f, 0.f};
-  flatVase.transform.scale = {3.f, 1.5f, 3.f};
-  gameObjects.emplace(flatVase.getId(), std::move(flatVase));
+  flatVase.model = flatVaseModel.get();
+  TransformComponent flatVaseTransform{};
+  flatVaseTransform.translation = {-.5f, .5f, 0.f};
+  flatVaseTransform.scale = {3.f, 1.5f, 3.f};
+  gameObjects.emplace(std::move(flatVase), flatVaseTransform);
 
-  lveModel = LveModel::createModelFromFile(lveDevice, "models/smooth_vase.obj");
   auto smoothVase = LveGameObject::createGameObject();
-  smoothVase.model = lveModel;
-  smoothVase.transform.translation = {.5f, .5f, 0.f};
-  smoothVase.transform.scale = {3.f, 1.5f, 3.f};
-  gameObjects.emplace(smoothVase.getId(), std::move(smoothVase));
+  smoothVase.model = smoothVaseModel.get();
+  TransformComponent smoothVaseTransform{};
+  smoothVaseTransform.translation = {.5f, .5f, 0.f};
+  smoothVaseTransform.scale = {3.f, 1.5f, 3.f};
+  gameObjects.emplace(std::move(smoothVase), smoothVaseTransform);
 
-  lveModel = LveModel::createModelFromFile(lveDevice, "models/quad.obj");
   auto floor = LveGameObject::createGameObject();
-  floor.model = lveModel;
-  floor.transform.translation = {0.f, .5f, 0.f};
-  floor.transform.scale = {3.f, 1.f, 3.f};
-  gameObjects.emplace(floor.getId(), std::move(floor));
+  floor.model = quadModel.get();
+  TransformComponent floorTransform{};
+  floorTransform.translation = {0.f, .5f, 0.f};
+  floorTransform.scale = {3.f, 1.f, 3.f};
+  gameObjects.emplace(std::move(floor), floorTransform);
 }
 
 }  // namespace lve
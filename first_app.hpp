@@ -3,11 +3,15 @@
 #include "lve_descriptors.hpp"
 #include "lve_device.hpp"
 #include "lve_game_object.hpp"
+#include "lve_geometry_pool.hpp"
+#include "lve_job_system.hpp"
 #include "lve_renderer.hpp"
 #include "lve_window.hpp"
 
 // std
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve {
@@ -15,8 +19,13 @@ class FirstApp {
  public:
   static constexpr int WIDTH = 800;
   static constexpr int HEIGHT = 600;
+  // simulate the next frame while the current one is recorded on a render thread
+  static constexpr bool PIPELINED_RENDERING = true;
 
-  FirstApp();
+  // A non zero headlessFrameCount renders that many frames offscreen without a window, with a
+  // fixed time step so the output is reproducible, then prints the average frame time. A non
+  // empty capturePath writes every frame to that file as a stream of PPM images.
+  explicit FirstApp(uint32_t headlessFrameCount = 0, std::string capturePath = {});
   ~FirstApp();
 
   FirstApp(const FirstApp &) = delete;
@@ -27,12 +36,17 @@ class FirstApp {
  private:
   void loadGameObjects();
 
-  LveWindow lveWindow{WIDTH, HEIGHT, "Vulkan Tutorial"};
-  LveDevice lveDevice{lveWindow};
-  LveRenderer lveRenderer{lveWindow, lveDevice};
+  uint32_t headlessFrameCount;
+  std::string capturePath;
+  std::unique_ptr<LveWindow> lveWindow;  // null when headless
+  std::unique_ptr<LveDevice> lveDevice;
+  std::unique_ptr<LveRenderer> lveRenderer;
+  // shared by model loading, transform updates, culling and command recording
+  LveJobSystem jobSystem{};
 
   // note: order of declarations matters
   std::unique_ptr<LveDescriptorPool> globalPool{};
+  std::unique_ptr<LveGeometryPool> geometryPool{};
   LveGameObject::Map gameObjects;
 };
 }  // namespace lve
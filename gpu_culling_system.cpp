@@ -0,0 +1,430 @@
+#include "gpu_culling_system.hpp"
+
+#include "lve_frustum.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+struct CullUbo {
+  glm::mat4 projectionView{1.f};
+  glm::vec4 frustumPlanes[6];
+  glm::vec2 pyramidSize{0.f};
+  uint32_t objectCount = 0;
+  uint32_t occlusionEnabled = 0;
+};
+
+struct DepthPyramidPushConstantData {
+  glm::ivec2 srcSize{0};
+  glm::ivec2 dstSize{0};
+};
+
+namespace {
+
+constexpr uint32_t CULL_GROUP_SIZE = 64;
+constexpr uint32_t PYRAMID_GROUP_SIZE = 8;
+// enough levels for a 64k depth attachment
+constexpr uint32_t MAX_PYRAMID_LEVELS = 16;
+
+void recordComputeBarrier(
+    VkCommandBuffer commandBuffer,
+    VkAccessFlags srcAccessMask,
+    VkAccessFlags dstAccessMask,
+    VkPipelineStageFlags dstStageMask) {
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      dstStageMask,
+      0,
+      1,
+      &barrier,
+      0,
+      nullptr,
+      0,
+      nullptr);
+}
+
+}  // namespace
+
+GpuCullingSystem::GpuCullingSystem(LveDevice& device, uint32_t framesInFlight)
+    : lveDevice{device}, framesInFlight{framesInFlight}, uboBuffers(framesInFlight) {
+  for (auto& uboBuffer : uboBuffers) {
+    uboBuffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        sizeof(CullUbo),
+        1,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    uboBuffer->map();
+  }
+
+  createDescriptorSetLayouts();
+  createPipelines();
+  createSampler();
+
+  cullPool = LveDescriptorPool::Builder(lveDevice)
+                 .setMaxSets(framesInFlight)
+                 .addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight)
+                 .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * framesInFlight)
+                 .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, framesInFlight)
+                 .build();
+  cullDescriptorSets.resize(framesInFlight);
+  for (auto& set : cullDescriptorSets) {
+    if (!cullPool->allocateDescriptor(cullSetLayout->getDescriptorSetLayout(), set)) {
+      throw std::runtime_error("failed to allocate cull descriptor set!");
+    }
+  }
+
+  // pyramid sets reference its per level views and are reallocated whenever it is recreated
+  uint32_t pyramidSetCount = MAX_PYRAMID_LEVELS + framesInFlight;
+  pyramidPool = LveDescriptorPool::Builder(lveDevice)
+                    .setMaxSets(pyramidSetCount)
+                    .addPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pyramidSetCount)
+                    .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramidSetCount)
+                    .build();
+}
+
+GpuCullingSystem::~GpuCullingSystem() {
+  destroyDepthPyramid();
+  vkDestroySampler(lveDevice.device(), depthSampler, nullptr);
+  vkDestroyPipelineLayout(lveDevice.device(), cullPipelineLayout, nullptr);
+  vkDestroyPipelineLayout(lveDevice.device(), pyramidPipelineLayout, nullptr);
+}
+
+void GpuCullingSystem::createDescriptorSetLayouts() {
+  cullSetLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+
+  pyramidSetLayout =
+      LveDescriptorSetLayout::Builder(lveDevice)
+          .addBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+          .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+          .build();
+}
+
+void GpuCullingSystem::createPipelines() {
+  VkDescriptorSetLayout cullLayouts[] = {cullSetLayout->getDescriptorSetLayout()};
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = cullLayouts;
+  if (vkCreatePipelineLayout(
+          lveDevice.device(),
+          &pipelineLayoutInfo,
+          nullptr,
+          &cullPipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(DepthPyramidPushConstantData);
+
+  VkDescriptorSetLayout pyramidLayouts[] = {pyramidSetLayout->getDescriptorSetLayout()};
+  pipelineLayoutInfo.pSetLayouts = pyramidLayouts;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  if (vkCreatePipelineLayout(
+          lveDevice.device(),
+          &pipelineLayoutInfo,
+          nullptr,
+          &pyramidPipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  cullPipeline = std::make_unique<LveComputePipeline>(
+      lveDevice,
+      "shaders/cull.comp.spv",
+      cullPipelineLayout);
+  pyramidPipeline = std::make_unique<LveComputePipeline>(
+      lveDevice,
+      "shaders/depth_pyramid.comp.spv",
+      pyramidPipelineLayout);
+}
+
+void GpuCullingSystem::createSampler() {
+  // only read with texelFetch, so filtering never applies
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  samplerInfo.minLod = 0.0f;
+  samplerInfo.maxLod = static_cast<float>(MAX_PYRAMID_LEVELS);
+  if (vkCreateSampler(lveDevice.device(), &samplerInfo, nullptr, &depthSampler) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create depth pyramid sampler!");
+  }
+}
+
+void GpuCullingSystem::createDepthPyramid(VkExtent2D extent) {
+  depthExtent = extent;
+  pyramidLevelExtents.clear();
+  VkExtent2D levelExtent{std::max(1u, extent.width / 2), std::max(1u, extent.height / 2)};
+  while (pyramidLevelExtents.size() < MAX_PYRAMID_LEVELS) {
+    pyramidLevelExtents.push_back(levelExtent);
+    if (levelExtent.width == 1 && levelExtent.height == 1) break;
+    levelExtent = {std::max(1u, levelExtent.width / 2), std::max(1u, levelExtent.height / 2)};
+  }
+  uint32_t levelCount = static_cast<uint32_t>(pyramidLevelExtents.size());
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = pyramidLevelExtents[0].width;
+  imageInfo.extent.height = pyramidLevelExtents[0].height;
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  lveDevice.createImageWithInfo(
+      imageInfo,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      pyramidImage,
+      pyramidAllocation);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = pyramidImage;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+  if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &pyramidView) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create depth pyramid image view!");
+  }
+
+  pyramidLevelViews.resize(levelCount);
+  viewInfo.subresourceRange.levelCount = 1;
+  for (uint32_t level = 0; level < levelCount; level++) {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    if (vkCreateImageView(lveDevice.device(), &viewInfo, nullptr, &pyramidLevelViews[level]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create depth pyramid image view!");
+    }
+  }
+
+  // level 0 reads whichever depth attachment the frame rendered to, so its sets are written when
+  // the pyramid is built
+  depthDescriptorSets.resize(framesInFlight);
+  for (auto& set : depthDescriptorSets) {
+    if (!pyramidPool->allocateDescriptor(pyramidSetLayout->getDescriptorSetLayout(), set)) {
+      throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+    }
+  }
+
+  levelDescriptorSets.resize(levelCount);
+  for (uint32_t level = 1; level < levelCount; level++) {
+    VkDescriptorImageInfo srcInfo{
+        depthSampler,
+        pyramidLevelViews[level - 1],
+        VK_IMAGE_LAYOUT_GENERAL};
+    VkDescriptorImageInfo dstInfo{
+        VK_NULL_HANDLE,
+        pyramidLevelViews[level],
+        VK_IMAGE_LAYOUT_GENERAL};
+    if (!LveDescriptorWriter(*pyramidSetLayout, *pyramidPool)
+             .writeImage(0, &srcInfo)
+             .writeImage(1, &dstInfo)
+             .build(levelDescriptorSets[level])) {
+      throw std::runtime_error("failed to allocate depth pyramid descriptor set!");
+    }
+  }
+  pyramidValid = false;
+}
+
+void GpuCullingSystem::destroyDepthPyramid() {
+  if (pyramidImage == VK_NULL_HANDLE) return;
+
+  pyramidPool->resetPool();
+  depthDescriptorSets.clear();
+  levelDescriptorSets.clear();
+  for (auto view : pyramidLevelViews) {
+    vkDestroyImageView(lveDevice.device(), view, nullptr);
+  }
+  pyramidLevelViews.clear();
+  vkDestroyImageView(lveDevice.device(), pyramidView, nullptr);
+  vkDestroyImage(lveDevice.device(), pyramidImage, nullptr);
+  lveDevice.freeAllocation(pyramidAllocation);
+  pyramidView = VK_NULL_HANDLE;
+  pyramidImage = VK_NULL_HANDLE;
+  pyramidValid = false;
+}
+
+void GpuCullingSystem::cull(
+    VkCommandBuffer commandBuffer,
+    int frameIndex,
+    const glm::mat4& projectionView,
+    VkExtent2D extent,
+    uint32_t objectCount,
+    LveBuffer& objectBuffer,
+    LveBuffer& drawCommandBuffer,
+    LveBuffer& instanceBuffer) {
+  assert(frameIndex < static_cast<int>(framesInFlight) && "Frame index out of range");
+  if (extent.width != depthExtent.width || extent.height != depthExtent.height) {
+    // the previous pyramid may still be read by the other frame in flight
+    vkDeviceWaitIdle(lveDevice.device());
+    destroyDepthPyramid();
+    createDepthPyramid(extent);
+
+    // the cull set always references the pyramid, so it must be in its layout even before the
+    // first build
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = pyramidImage;
+    barrier.subresourceRange = {
+        VK_IMAGE_ASPECT_COLOR_BIT,
+        0,
+        static_cast<uint32_t>(pyramidLevelViews.size()),
+        0,
+        1};
+    vkCmdPipelineBarrier(
+        commandBuffer,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0,
+        0,
+        nullptr,
+        0,
+        nullptr,
+        1,
+        &barrier);
+  }
+
+  CullUbo ubo{};
+  ubo.projectionView = projectionView;
+  LveFrustum frustum{projectionView};
+  for (int i = 0; i < 6; i++) {
+    ubo.frustumPlanes[i] = frustum.getPlane(i);
+  }
+  ubo.pyramidSize = {
+      static_cast<float>(pyramidLevelExtents[0].width),
+      static_cast<float>(pyramidLevelExtents[0].height)};
+  ubo.objectCount = objectCount;
+  ubo.occlusionEnabled = occlusionCullingEnabled && pyramidValid ? 1 : 0;
+  uboBuffers[frameIndex]->writeToBuffer(&ubo);
+  uboBuffers[frameIndex]->flush();
+
+  auto uboInfo = uboBuffers[frameIndex]->descriptorInfo();
+  auto objectInfo = objectBuffer.descriptorInfo();
+  auto drawCommandInfo = drawCommandBuffer.descriptorInfo();
+  auto instanceInfo = instanceBuffer.descriptorInfo();
+  VkDescriptorImageInfo pyramidInfo{depthSampler, pyramidView, VK_IMAGE_LAYOUT_GENERAL};
+  LveDescriptorWriter(*cullSetLayout, *cullPool)
+      .writeBuffer(0, &uboInfo)
+      .writeBuffer(1, &objectInfo)
+      .writeBuffer(2, &drawCommandInfo)
+      .writeBuffer(3, &instanceInfo)
+      .writeImage(4, &pyramidInfo)
+      .overwrite(cullDescriptorSets[frameIndex]);
+
+  cullPipeline->bind(commandBuffer);
+  vkCmdBindDescriptorSets(
+      commandBuffer,
+      VK_PIPELINE_BIND_POINT_COMPUTE,
+      cullPipelineLayout,
+      0,
+      1,
+      &cullDescriptorSets[frameIndex],
+      0,
+      nullptr);
+  vkCmdDispatch(commandBuffer, (objectCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+  recordComputeBarrier(
+      commandBuffer,
+      VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
+      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+}
+
+void GpuCullingSystem::buildDepthPyramid(
+    VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView) {
+  assert(pyramidImage != VK_NULL_HANDLE && "Cannot build depth pyramid before culling");
+
+  // this frame's cull must finish sampling the pyramid before it is overwritten, the depth
+  // attachment itself is made readable by the render pass's outgoing dependency
+  recordComputeBarrier(commandBuffer, 0, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+  VkDescriptorImageInfo depthInfo{
+      depthSampler,
+      depthView,
+      VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  VkDescriptorImageInfo levelInfo{VK_NULL_HANDLE, pyramidLevelViews[0], VK_IMAGE_LAYOUT_GENERAL};
+  LveDescriptorWriter(*pyramidSetLayout, *pyramidPool)
+      .writeImage(0, &depthInfo)
+      .writeImage(1, &levelInfo)
+      .overwrite(depthDescriptorSets[frameIndex]);
+
+  pyramidPipeline->bind(commandBuffer);
+  VkExtent2D srcExtent = depthExtent;
+  for (size_t level = 0; level < pyramidLevelExtents.size(); level++) {
+    VkDescriptorSet set = level == 0 ? depthDescriptorSets[frameIndex] : levelDescriptorSets[level];
+    vkCmdBindDescriptorSets(
+        commandBuffer,
+        VK_PIPELINE_BIND_POINT_COMPUTE,
+        pyramidPipelineLayout,
+        0,
+        1,
+        &set,
+        0,
+        nullptr);
+
+    VkExtent2D dstExtent = pyramidLevelExtents[level];
+    DepthPyramidPushConstantData push{};
+    push.srcSize = {static_cast<int>(srcExtent.width), static_cast<int>(srcExtent.height)};
+    push.dstSize = {static_cast<int>(dstExtent.width), static_cast<int>(dstExtent.height)};
+    vkCmdPushConstants(
+        commandBuffer,
+        pyramidPipelineLayout,
+        VK_SHADER_STAGE_COMPUTE_BIT,
+        0,
+        sizeof(DepthPyramidPushConstantData),
+        &push);
+    vkCmdDispatch(
+        commandBuffer,
+        (dstExtent.width + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+        (dstExtent.height + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE,
+        1);
+
+    // also covers the next frame's cull, which samples the finished pyramid
+    recordComputeBarrier(
+        commandBuffer,
+        VK_ACCESS_SHADER_WRITE_BIT,
+        VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    srcExtent = dstExtent;
+  }
+  pyramidValid = true;
+}
+
+}  // namespace lve
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_descriptors.hpp"
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Frustum and occlusion culls objects in a compute shader and compacts the survivors into the
+// instance ranges of per batch indirect draw commands. Occlusion is tested against a max depth
+// pyramid built from the previous frame's depth attachment, so an object that comes into view
+// from behind an occluder may show up one frame late.
+class GpuCullingSystem {
+ public:
+  // objects with this batch index are skipped, lets callers keep a row for every object
+  static constexpr uint32_t NO_BATCH = UINT32_MAX;
+
+  // Layout shared with shaders/cull.comp
+  struct ObjectData {
+    glm::mat4 modelMatrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+    glm::vec4 boundingSphere{0.f};  // model space center and radius
+    uint32_t batchIndex = 0;
+    uint32_t firstInstance = 0;  // first instance of the batch
+    uint32_t padding[2]{};
+  };
+
+  // Indexed or non indexed draw command, both have instanceCount as their second member which the
+  // cull shader increments for every surviving object
+  struct DrawCommand {
+    uint32_t data[5]{};
+  };
+
+  // Per frame resources are created for framesInFlight frames, frame indices must stay below it
+  GpuCullingSystem(LveDevice &device, uint32_t framesInFlight);
+  ~GpuCullingSystem();
+
+  GpuCullingSystem(const GpuCullingSystem &) = delete;
+  GpuCullingSystem &operator=(const GpuCullingSystem &) = delete;
+
+  // Records the cull dispatch for objectCount objects and the barrier that makes its results
+  // visible to indirect draws and vertex input. Draw commands must be written with an
+  // instanceCount of 0. Must be recorded outside a render pass.
+  void cull(
+      VkCommandBuffer commandBuffer,
+      int frameIndex,
+      const glm::mat4 &projectionView,
+      VkExtent2D depthExtent,
+      uint32_t objectCount,
+      LveBuffer &objectBuffer,
+      LveBuffer &drawCommandBuffer,
+      LveBuffer &instanceBuffer);
+
+  // Records the depth pyramid build from the depth attachment rendered this frame, after the
+  // render pass has ended. Must follow cull in the same frame.
+  void buildDepthPyramid(VkCommandBuffer commandBuffer, int frameIndex, VkImageView depthView);
+  // Instead of buildDepthPyramid when this frame's depth was not kept, the pyramid is then too old
+  // for the next cull to test against
+  void invalidateDepthPyramid() { pyramidValid = false; }
+
+  void setOcclusionCullingEnabled(bool enabled) { occlusionCullingEnabled = enabled; }
+  bool isOcclusionCullingEnabled() const { return occlusionCullingEnabled; }
+
+ private:
+  void createDescriptorSetLayouts();
+  void createPipelines();
+  void createSampler();
+  void createDepthPyramid(VkExtent2D depthExtent);
+  void destroyDepthPyramid();
+
+  LveDevice &lveDevice;
+  uint32_t framesInFlight;
+
+  std::unique_ptr<LveDescriptorPool> cullPool;
+  std::unique_ptr<LveDescriptorPool> pyramidPool;
+  std::unique_ptr<LveDescriptorSetLayout> cullSetLayout;
+  std::unique_ptr<LveDescriptorSetLayout> pyramidSetLayout;
+  VkPipelineLayout cullPipelineLayout;
+  VkPipelineLayout pyramidPipelineLayout;
+  std::unique_ptr<LveComputePipeline> cullPipeline;
+  std::unique_ptr<LveComputePipeline> pyramidPipeline;
+
+  std::vector<std::unique_ptr<LveBuffer>> uboBuffers;
+  std::vector<VkDescriptorSet> cullDescriptorSets;
+  VkSampler depthSampler;
+
+  // max depth pyramid, level 0 is half the depth attachment resolution
+  VkExtent2D depthExtent{0, 0};
+  VkImage pyramidImage = VK_NULL_HANDLE;
+  LveAllocation pyramidAllocation{};
+  VkImageView pyramidView = VK_NULL_HANDLE;
+  std::vector<VkImageView> pyramidLevelViews;
+  std::vector<VkExtent2D> pyramidLevelExtents;
+  std::vector<VkDescriptorSet> depthDescriptorSets;  // level 0 sources, one per frame in flight
+  std::vector<VkDescriptorSet> levelDescriptorSets;  // level i built from level i - 1
+  bool pyramidValid = false;
+
+  bool occlusionCullingEnabled{true};
+};
+
+}  // namespace lve
@@ -0,0 +1,180 @@
+#include "lve_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace lve {
+
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+LveAllocator::LveAllocator(
+    VkDevice device, VkPhysicalDevice physicalDevice, VkDeviceSize preferredBlockSize)
+    : device{device}, preferredBlockSize{preferredBlockSize} {
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  nonCoherentAtomSize = properties.limits.nonCoherentAtomSize;
+}
+
+LveAllocator::~LveAllocator() {
+  for (auto &block : blocks) {
+    assert(block->allocationCount == 0 && "Memory block destroyed with live allocations");
+    destroyBlock(*block);
+  }
+}
+
+LveAllocation LveAllocator::allocate(
+    const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear) {
+  uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+  VkMemoryPropertyFlags typeFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+
+  // host ranges of non coherent memory are flushed in whole atoms, keep them from overlapping
+  VkDeviceSize alignment = requirements.alignment;
+  VkDeviceSize size = requirements.size;
+  if ((typeFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      !(typeFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+    alignment = std::max(alignment, nonCoherentAtomSize);
+    size = alignUp(size, nonCoherentAtomSize);
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  LveAllocation allocation{};
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  allocation.linear = linear;
+
+  VkDeviceSize blockSize = getBlockSize(memoryTypeIndex);
+  if (size > blockSize / 2) {
+    Block &block = createBlock(memoryTypeIndex, linear, size, true);
+    allocateFromBlock(block, size, alignment, allocation);
+    return allocation;
+  }
+
+  for (auto &block : blocks) {
+    if (!block->dedicated && block->memoryTypeIndex == memoryTypeIndex && block->linear == linear &&
+        allocateFromBlock(*block, size, alignment, allocation)) {
+      return allocation;
+    }
+  }
+
+  Block &block = createBlock(memoryTypeIndex, linear, blockSize, false);
+  allocateFromBlock(block, size, alignment, allocation);
+  return allocation;
+}
+
+void LveAllocator::free(LveAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock{mutex};
+
+  auto blockIt = std::find_if(blocks.begin(), blocks.end(), [&](const auto &block) {
+    return block->memory == allocation.memory;
+  });
+  assert(blockIt != blocks.end() && "Freeing memory that was not allocated by this allocator");
+  Block &block = **blockIt;
+
+  block.ranges.free(allocation.range);
+  block.allocationCount--;
+  if (block.dedicated && block.allocationCount == 0) {
+    destroyBlock(block);
+    blocks.erase(blockIt);
+  }
+
+  allocation = LveAllocation{};
+}
+
+LveAllocatorStats LveAllocator::getStats() const {
+  std::lock_guard<std::mutex> lock{mutex};
+
+  LveAllocatorStats stats{};
+  for (auto &block : blocks) {
+    stats.blockCount++;
+    stats.allocationCount += block->allocationCount;
+    stats.blockBytes += block->ranges.getSize();
+    stats.usedBytes += block->ranges.getSize() - block->ranges.getFreeSize();
+    stats.freeRangeCount += block->ranges.getFreeRangeCount();
+    stats.largestFreeRange = std::max(stats.largestFreeRange, block->ranges.getLargestFreeRange());
+  }
+  return stats;
+}
+
+uint32_t LveAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1 << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize LveAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+  // small heaps (eg the host visible device local window) get proportionally smaller blocks
+  uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+  return std::min(preferredBlockSize, heapSize / 8);
+}
+
+LveAllocator::Block &LveAllocator::createBlock(
+    uint32_t memoryTypeIndex, bool linear, VkDeviceSize size, bool dedicated) {
+  auto block = std::make_unique<Block>(size);
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->linear = linear;
+  block->dedicated = dedicated;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate memory block!");
+  }
+
+  if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, block->memory, nullptr);
+      throw std::runtime_error("failed to map memory block!");
+    }
+  }
+
+  blocks.push_back(std::move(block));
+  return *blocks.back();
+}
+
+void LveAllocator::destroyBlock(Block &block) {
+  if (block.mapped) {
+    vkUnmapMemory(device, block.memory);
+  }
+  vkFreeMemory(device, block.memory, nullptr);
+}
+
+bool LveAllocator::allocateFromBlock(
+    Block &block, VkDeviceSize size, VkDeviceSize alignment, LveAllocation &allocation) {
+  VkDeviceSize offset;
+  if (!block.ranges.allocate(size, alignment, allocation.range, offset)) {
+    return false;
+  }
+
+  allocation.memory = block.memory;
+  allocation.offset = offset;
+  allocation.size = size;
+  allocation.mapped = block.mapped ? static_cast<char *>(block.mapped) + offset : nullptr;
+  block.allocationCount++;
+  return true;
+}
+
+}  // namespace lve
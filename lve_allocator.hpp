@@ -0,0 +1,97 @@
+#pragma once
+
+#include "lve_range_allocator.hpp"
+
+// libs
+#include <vulkan/vulkan.h>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lve {
+
+// A range of device memory handed out by LveAllocator
+struct LveAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr;  // points at offset when the memory is host visible
+
+  // bookkeeping used to return the range to its block
+  uint32_t memoryTypeIndex = 0;
+  bool linear = true;
+  LveRangeAllocator::Range range{};
+};
+
+struct LveAllocatorStats {
+  uint32_t blockCount = 0;
+  uint32_t allocationCount = 0;
+  uint32_t freeRangeCount = 0;
+  VkDeviceSize blockBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+
+  // 0 when all free memory is one contiguous range, approaching 1 as it splinters
+  float fragmentation() const {
+    VkDeviceSize freeBytes = blockBytes - usedBytes;
+    return freeBytes == 0 ? 0.f : 1.f - static_cast<float>(largestFreeRange) / freeBytes;
+  }
+};
+
+// Sub-allocates buffers and images out of large VkDeviceMemory blocks, one set of blocks per
+// memory type. Linear (buffer) and optimal (image) resources never share a block, so
+// bufferImageGranularity does not need to be honoured between neighbours. Host visible blocks are
+// mapped once for their whole lifetime.
+class LveAllocator {
+ public:
+  static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  LveAllocator(
+      VkDevice device,
+      VkPhysicalDevice physicalDevice,
+      VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+  ~LveAllocator();
+
+  LveAllocator(const LveAllocator &) = delete;
+  LveAllocator &operator=(const LveAllocator &) = delete;
+
+  LveAllocation allocate(
+      const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties, bool linear);
+  void free(LveAllocation &allocation);
+
+  LveAllocatorStats getStats() const;
+  VkDeviceSize getNonCoherentAtomSize() const { return nonCoherentAtomSize; }
+
+ private:
+  struct Block {
+    explicit Block(VkDeviceSize size) : ranges{size} {}
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    uint32_t memoryTypeIndex = 0;
+    bool linear = true;
+    bool dedicated = false;  // sized for a single large allocation, released once empty
+    uint32_t allocationCount = 0;
+    LveRangeAllocator ranges;
+  };
+
+  uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+  VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+  Block &createBlock(uint32_t memoryTypeIndex, bool linear, VkDeviceSize size, bool dedicated);
+  void destroyBlock(Block &block);
+  bool allocateFromBlock(
+      Block &block, VkDeviceSize size, VkDeviceSize alignment, LveAllocation &allocation);
+
+  VkDevice device;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize preferredBlockSize;
+  VkDeviceSize nonCoherentAtomSize;
+
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<Block>> blocks{};
+};
+
+}  // namespace lve
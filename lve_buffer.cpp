@@ -43,18 +43,45 @@ LveBuffer::LveBuffer(
       memoryPropertyFlags{memoryPropertyFlags} {
   alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
   bufferSize = alignmentSize * instanceCount;
-  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, memory);
+  device.createBuffer(bufferSize, usageFlags, memoryPropertyFlags, buffer, allocation);
 }
 
 LveBuffer::~LveBuffer() {
   unmap();
   vkDestroyBuffer(lveDevice.device(), buffer, nullptr);
-  vkFreeMemory(lveDevice.device(), memory, nullptr);
+  lveDevice.freeAllocation(allocation);
+}
+
+/**
+ * Translates a range of the buffer into a range of its memory block, expanded to whole
+ * nonCoherentAtomSize units as required for flushing and invalidating
+ *
+ * @note The allocator aligns non coherent allocations to whole atoms, so their ranges stay inside
+ * the allocation. The end of any other allocation need not lie on an atom nor at the end of the
+ * memory, a range reaching past it is flushed or invalidated with VK_WHOLE_SIZE instead.
+ */
+VkMappedMemoryRange LveBuffer::getMappedRange(VkDeviceSize size, VkDeviceSize offset) const {
+  VkDeviceSize atomSize = lveDevice.allocator().getNonCoherentAtomSize();
+  VkDeviceSize allocationEnd = allocation.offset + allocation.size;
+  VkDeviceSize begin = allocation.offset + offset;
+  VkDeviceSize end = size == VK_WHOLE_SIZE ? allocationEnd : begin + size;
+  begin = begin / atomSize * atomSize;
+  end = (end + atomSize - 1) / atomSize * atomSize;
+
+  VkMappedMemoryRange mappedRange = {};
+  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+  mappedRange.memory = allocation.memory;
+  mappedRange.offset = begin;
+  mappedRange.size = end > allocationEnd ? VK_WHOLE_SIZE : end - begin;
+  return mappedRange;
 }
 
 /**
  * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
  *
+ * @note Host visible memory stays mapped by the allocator, so this only hands out the pointer and
+ * remembers the size of the range, which writeToBuffer stays within
+ *
  * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
  * buffer range.
  * @param offset (Optional) Byte offset from beginning
@@ -62,27 +89,33 @@ LveBuffer::~LveBuffer() {
  * @return VkResult of the buffer mapping call
  */
 VkResult LveBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-  assert(buffer && memory && "Called map on buffer before create");
-  return vkMapMemory(lveDevice.device(), memory, offset, size, 0, &mapped);
+  assert(buffer && allocation.memory && "Called map on buffer before create");
+  assert(
+      offset <= bufferSize && (size == VK_WHOLE_SIZE || size <= bufferSize - offset) &&
+      "Cannot map a range outside the buffer");
+  if (!allocation.mapped) {
+    return VK_ERROR_MEMORY_MAP_FAILED;
+  }
+  mapped = static_cast<char *>(allocation.mapped) + offset;
+  mappedSize = size == VK_WHOLE_SIZE ? bufferSize - offset : size;
+  return VK_SUCCESS;
 }
 
 /**
  * Unmap a mapped memory range
  *
- * @note Does not return a result as vkUnmapMemory can't fail
+ * @note The memory block itself stays mapped until it is freed
  */
 void LveBuffer::unmap() {
-  if (mapped) {
-    vkUnmapMemory(lveDevice.device(), memory);
-    mapped = nullptr;
-  }
+  mapped = nullptr;
+  mappedSize = 0;
 }
 
 /**
  * Copies the specified data to the mapped buffer. Default value writes whole buffer range
  *
  * @param data Pointer to the data to copy
- * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to flush the complete buffer
+ * @param size (Optional) Size of the data to copy. Pass VK_WHOLE_SIZE to write the complete mapped
  * range.
  * @param offset (Optional) Byte offset from beginning of mapped region
  *
@@ -91,8 +124,9 @@ void LveBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset
   assert(mapped && "Cannot copy to unmapped buffer");
 
   if (size == VK_WHOLE_SIZE) {
-    memcpy(mapped, data, bufferSize);
+    memcpy(mapped, data, mappedSize);
   } else {
+    assert(offset <= mappedSize && size <= mappedSize - offset && "Write exceeds mapped range");
     char *memOffset = (char *)mapped;
     memOffset += offset;
     memcpy(memOffset, data, size);
@@ -111,11 +145,7 @@ void LveBuffer::writeToBuffer(void *data, VkDeviceSize size, VkDeviceSize offset
  * @return VkResult of the flush call
  */
 VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
   return vkFlushMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
@@ -131,11 +161,7 @@ VkResult LveBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
  * @return VkResult of the invalidate call
  */
 VkResult LveBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-  VkMappedMemoryRange mappedRange = {};
-  mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-  mappedRange.memory = memory;
-  mappedRange.offset = offset;
-  mappedRange.size = size;
+  VkMappedMemoryRange mappedRange = getMappedRange(size, offset);
   return vkInvalidateMappedMemoryRanges(lveDevice.device(), 1, &mappedRange);
 }
 
@@ -42,11 +42,13 @@ class LveBuffer {
 
  private:
   static VkDeviceSize getAlignment(VkDeviceSize instanceSize, VkDeviceSize minOffsetAlignment);
+  VkMappedMemoryRange getMappedRange(VkDeviceSize size, VkDeviceSize offset) const;
 
   LveDevice& lveDevice;
   void* mapped = nullptr;
+  VkDeviceSize mappedSize = 0;
   VkBuffer buffer = VK_NULL_HANDLE;
-  VkDeviceMemory memory = VK_NULL_HANDLE;
+  LveAllocation allocation{};
 
   VkDeviceSize bufferSize;
   uint32_t instanceCount;
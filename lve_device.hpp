@@ -1,13 +1,17 @@
 #pragma once
 
+#include "lve_allocator.hpp"
 #include "lve_window.hpp"
 
 // std lib headers
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
+class LveTransferManager;
+
 struct SwapChainSupportDetails {
   VkSurfaceCapabilitiesKHR capabilities;
   std::vector<VkSurfaceFormatKHR> formats;
@@ -17,8 +21,10 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndices {
   uint32_t graphicsFamily;
   uint32_t presentFamily;
+  uint32_t transferFamily;
   bool graphicsFamilyHasValue = false;
   bool presentFamilyHasValue = false;
+  bool transferFamilyHasValue = false;  // a transfer only family, separate from graphics
   bool isComplete() { return graphicsFamilyHasValue && presentFamilyHasValue; }
 };
 
@@ -30,7 +36,17 @@ class LveDevice {
   const bool enableValidationLayers = true;
 #endif
 
-  LveDevice(LveWindow &window);
+  // Pipelines compiled in earlier runs are loaded from this file, relative to the working
+  // directory like the shader and model paths
+  static constexpr const char *PIPELINE_CACHE_FILE = "pipeline_cache.bin";
+
+  // With useDedicatedTransferQueue, uploads go through a transfer only queue when the device
+  // exposes one, otherwise they share the graphics queue
+  LveDevice(LveWindow &window, bool useDedicatedTransferQueue = false);
+  // Headless device without a window surface or VK_KHR_swapchain, for rendering offscreen on
+  // machines without a display
+  explicit LveDevice(bool useDedicatedTransferQueue = false);
+  // Writes the pipeline cache back to PIPELINE_CACHE_FILE
   ~LveDevice();
 
   // Not copyable or movable
@@ -42,8 +58,15 @@ class LveDevice {
   VkCommandPool getCommandPool() { return commandPool; }
   VkDevice device() { return device_; }
   VkSurfaceKHR surface() { return surface_; }
+  // Pass to every vkCreate*Pipelines call, the driver synchronizes access to it
+  VkPipelineCache pipelineCache() { return pipelineCache_; }
+  bool isHeadless() const { return window == nullptr; }
   VkQueue graphicsQueue() { return graphicsQueue_; }
   VkQueue presentQueue() { return presentQueue_; }
+  VkQueue transferQueue() { return transferQueue_; }
+  uint32_t transferQueueFamily() { return transferQueueFamily_; }
+  bool hasDedicatedTransferQueue() { return transferQueue_ != graphicsQueue_; }
+  LveTransferManager &transferManager() { return *transferManager_; }
 
   SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
   uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -52,12 +75,13 @@ class LveDevice {
       const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
   // Buffer Helper Functions
+  // Memory for buffers and images is sub-allocated, release it with freeAllocation
   void createBuffer(
       VkDeviceSize size,
       VkBufferUsageFlags usage,
       VkMemoryPropertyFlags properties,
       VkBuffer &buffer,
-      VkDeviceMemory &bufferMemory);
+      LveAllocation &bufferAllocation);
   VkCommandBuffer beginSingleTimeCommands();
   void endSingleTimeCommands(VkCommandBuffer commandBuffer);
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
@@ -68,17 +92,26 @@ class LveDevice {
       const VkImageCreateInfo &imageInfo,
       VkMemoryPropertyFlags properties,
       VkImage &image,
-      VkDeviceMemory &imageMemory);
+      LveAllocation &imageAllocation);
+  void freeAllocation(LveAllocation &allocation) { allocator_->free(allocation); }
+  LveAllocator &allocator() { return *allocator_; }
+
+  // Writes the pipeline cache to PIPELINE_CACHE_FILE, e.g. after warming up pipelines. Returns
+  // false when the file could not be written.
+  bool savePipelineCache();
 
   VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceFeatures enabledFeatures{};
 
  private:
+  void init();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
   void createCommandPool();
+  void createPipelineCache();
 
   // helper functions
   bool isDeviceSuitable(VkPhysicalDevice device);
@@ -88,21 +121,31 @@ class LveDevice {
   void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo);
   void hasGflwRequiredInstanceExtensions();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isPipelineCacheCompatible(const std::vector<char> &cacheData);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
   VkInstance instance;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-  LveWindow &window;
+  LveWindow *window = nullptr;
   VkCommandPool commandPool;
 
   VkDevice device_;
-  VkSurfaceKHR surface_;
+  VkSurfaceKHR surface_ = VK_NULL_HANDLE;
+  VkPipelineCache pipelineCache_ = VK_NULL_HANDLE;
   VkQueue graphicsQueue_;
   VkQueue presentQueue_;
+  VkQueue transferQueue_;
+  uint32_t graphicsQueueFamily_;
+  uint32_t transferQueueFamily_;
+  bool useDedicatedTransferQueue;
+
+  std::unique_ptr<LveAllocator> allocator_;
+  std::unique_ptr<LveTransferManager> transferManager_;
 
   const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-  const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+  // VK_KHR_swapchain is only required with a window
+  std::vector<const char *> deviceExtensions;
 };
 
 }  // namespace lve
@@ -0,0 +1,256 @@
+#include "lve_frame_capture.hpp"
+
+// std
+#include <cassert>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t BYTES_PER_PIXEL = 4;
+
+void recordLayoutTransition(
+    VkCommandBuffer commandBuffer,
+    VkImage image,
+    VkImageLayout oldLayout,
+    VkImageLayout newLayout,
+    VkAccessFlags srcAccessMask,
+    VkAccessFlags dstAccessMask,
+    VkPipelineStageFlags srcStageMask,
+    VkPipelineStageFlags dstStageMask) {
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccessMask;
+  barrier.dstAccessMask = dstAccessMask;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = newLayout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      srcStageMask,
+      dstStageMask,
+      0,
+      0,
+      nullptr,
+      0,
+      nullptr,
+      1,
+      &barrier);
+}
+
+bool isBgra(VkFormat format) {
+  return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+}
+
+}  // namespace
+
+LveFrameCapture::LveFrameCapture(
+    LveDevice& device, uint32_t framesInFlight, Callback callback, LveJobSystem* jobSystem)
+    : lveDevice{device},
+      callback{std::move(callback)},
+      jobSystem{jobSystem},
+      framesInFlight{framesInFlight},
+      readbacks(2 * framesInFlight) {
+  assert(framesInFlight > 0 && "Frame capture needs at least one frame in flight");
+}
+
+LveFrameCapture::~LveFrameCapture() {
+  // delivery jobs reference the readbacks, callback errors are only reported through flush
+  for (auto& readback : readbacks) {
+    try {
+      waitForDelivery(readback);
+    } catch (...) {
+    }
+  }
+}
+
+void LveFrameCapture::beginFrame(int frameIndex) {
+  // the fence waited on by beginFrame covers everything recorded under this frame index so far
+  for (auto readback : pendingReadbacks) {
+    if (readback->frameIndex == frameIndex) {
+      readback->ready = true;
+    }
+  }
+  deliverReady();
+}
+
+void LveFrameCapture::capture(
+    VkCommandBuffer commandBuffer,
+    int frameIndex,
+    VkImage image,
+    VkImageLayout layout,
+    VkFormat format,
+    VkExtent2D extent) {
+  assert(frameIndex < static_cast<int>(framesInFlight) && "Frame index out of range");
+  VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * BYTES_PER_PIXEL;
+  Readback& readback = acquireReadback(size);
+  readback.frame.frameNumber = nextFrameNumber++;
+  readback.frame.width = extent.width;
+  readback.frame.height = extent.height;
+  readback.frame.format = format;
+  readback.frame.pixels = nullptr;
+  readback.frameIndex = frameIndex;
+  readback.pending = true;
+  readback.ready = false;
+  pendingReadbacks.push_back(&readback);
+
+  // the previous contents are kept, the render pass has finished writing them
+  if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+    recordLayoutTransition(
+        commandBuffer,
+        image,
+        layout,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        VK_ACCESS_TRANSFER_READ_BIT,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT);
+  }
+
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.bufferRowLength = 0;
+  region.bufferImageHeight = 0;
+  region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {extent.width, extent.height, 1};
+  vkCmdCopyImageToBuffer(
+      commandBuffer,
+      image,
+      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+      readback.buffer->getBuffer(),
+      1,
+      &region);
+
+  // make the copy visible to the host once the frame's fence has signaled
+  VkBufferMemoryBarrier bufferBarrier{};
+  bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  bufferBarrier.buffer = readback.buffer->getBuffer();
+  bufferBarrier.offset = 0;
+  bufferBarrier.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(
+      commandBuffer,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      0,
+      0,
+      nullptr,
+      1,
+      &bufferBarrier,
+      0,
+      nullptr);
+
+  if (layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL) {
+    // presentation waits on a semaphore, which makes the layout change visible to it
+    recordLayoutTransition(
+        commandBuffer,
+        image,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        layout,
+        VK_ACCESS_TRANSFER_READ_BIT,
+        0,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+  }
+}
+
+void LveFrameCapture::flush() {
+  for (auto readback : pendingReadbacks) {
+    readback->ready = true;
+  }
+  deliverReady();
+
+  for (auto& readback : readbacks) {
+    waitForDelivery(readback);
+  }
+}
+
+void LveFrameCapture::writePpm(const Frame& frame, std::ostream& out) {
+  out << "P6\n" << frame.width << ' ' << frame.height << "\n255\n";
+
+  bool bgra = isBgra(frame.format);
+  std::vector<char> row(frame.width * 3);
+  for (uint32_t y = 0; y < frame.height; y++) {
+    const uint8_t* pixel = frame.pixels + static_cast<size_t>(y) * frame.width * BYTES_PER_PIXEL;
+    for (uint32_t x = 0; x < frame.width; x++, pixel += BYTES_PER_PIXEL) {
+      row[x * 3 + 0] = static_cast<char>(pixel[bgra ? 2 : 0]);
+      row[x * 3 + 1] = static_cast<char>(pixel[1]);
+      row[x * 3 + 2] = static_cast<char>(pixel[bgra ? 0 : 2]);
+    }
+    out.write(row.data(), row.size());
+  }
+}
+
+LveFrameCapture::Readback& LveFrameCapture::acquireReadback(VkDeviceSize size) {
+  // every capture lands within framesInFlight frames, so no more than framesInFlight are
+  // pending and the ring always has a free readback
+  assert(pendingReadbacks.size() < readbacks.size() && "beginFrame must be called every frame");
+  while (readbacks[nextReadback].pending) {
+    nextReadback = (nextReadback + 1) % readbacks.size();
+  }
+  Readback& readback = readbacks[nextReadback];
+  nextReadback = (nextReadback + 1) % readbacks.size();
+
+  // the callback may still be reading the frame this readback delivered last
+  waitForDelivery(readback);
+
+  if (readback.buffer == nullptr || readback.buffer->getBufferSize() != size) {
+    readback.buffer = std::make_unique<LveBuffer>(
+        lveDevice,
+        size,
+        1,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    readback.buffer->map();
+  }
+  return readback;
+}
+
+void LveFrameCapture::deliverReady() {
+  while (!pendingReadbacks.empty() && pendingReadbacks.front()->ready) {
+    Readback* readback = pendingReadbacks.front();
+    pendingReadbacks.pop_front();
+    deliver(*readback);
+  }
+}
+
+void LveFrameCapture::deliver(Readback& readback) {
+  readback.pending = false;
+
+  // the memory may not be host coherent
+  readback.buffer->invalidate();
+  readback.frame.pixels = static_cast<const uint8_t*>(readback.buffer->getMappedMemory());
+
+  if (jobSystem == nullptr) {
+    callback(readback.frame);
+    return;
+  }
+
+  // callbacks may do blocking I/O, as background jobs a render thread waiting on frame work never
+  // runs them inline
+  auto job = [this, &readback]() { callback(readback.frame); };
+  auto priority = LveJobSystem::Priority::Background;
+  if (lastDelivered != nullptr && lastDelivered != &readback) {
+    jobSystem->runAfter(lastDelivered->delivered, job, &readback.delivered, priority);
+  } else {
+    jobSystem->run(job, &readback.delivered, priority);
+  }
+  lastDelivered = &readback;
+}
+
+void LveFrameCapture::waitForDelivery(Readback& readback) {
+  if (jobSystem != nullptr) {
+    jobSystem->wait(readback.delivered);
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_job_system.hpp"
+
+// std
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+namespace lve {
+
+// Reads rendered frames back to the host without stalling the render loop. A frame is copied into
+// one of a ring of host visible buffers and handed to the callback once its frame index comes
+// around again, when LveRenderer::beginFrame has already waited on the fence of the frame that
+// recorded the copy. Frames therefore arrive framesInFlight frames late, flush delivers the rest.
+class LveFrameCapture {
+ public:
+  struct Frame {
+    uint64_t frameNumber = 0;  // counts captures, starting at 0
+    uint32_t width = 0;
+    uint32_t height = 0;
+    VkFormat format = VK_FORMAT_UNDEFINED;  // 4 bytes per pixel, RGBA or BGRA order
+    const uint8_t *pixels = nullptr;        // tightly packed rows, top row first
+  };
+
+  // The pixels are only valid during the call
+  using Callback = std::function<void(const Frame &frame)>;
+
+  // framesInFlight is the renderer's, the readback ring is sized for it. With a job system, the
+  // callback runs as a background job so slow consumers such as disk writes don't hold up
+  // recording. Calls still happen one at a time and in frame order.
+  LveFrameCapture(
+      LveDevice &device,
+      uint32_t framesInFlight,
+      Callback callback,
+      LveJobSystem *jobSystem = nullptr);
+  ~LveFrameCapture();
+
+  LveFrameCapture(const LveFrameCapture &) = delete;
+  LveFrameCapture &operator=(const LveFrameCapture &) = delete;
+
+  // Delivers the captures that have landed. Call it every frame after LveRenderer::beginFrame,
+  // whether or not the frame is captured. A renderer with different frames in flight needs a new
+  // capture, flush this one first.
+  void beginFrame(int frameIndex);
+
+  // Records the copy of image, a 4 byte per pixel color image in layout, and returns it to layout.
+  // Must be recorded outside a render pass, after the commands rendering the image. The image
+  // needs VK_IMAGE_USAGE_TRANSFER_SRC_BIT.
+  void capture(
+      VkCommandBuffer commandBuffer,
+      int frameIndex,
+      VkImage image,
+      VkImageLayout layout,
+      VkFormat format,
+      VkExtent2D extent);
+
+  // Delivers every capture still held back, in order, and waits for the callbacks. The device
+  // must be idle. Rethrows an exception thrown by a callback run as a job.
+  void flush();
+
+  // Writes frame as a binary PPM image. PPM images can be concatenated into one stream, which
+  // video encoders such as ffmpeg read with -f image2pipe.
+  static void writePpm(const Frame &frame, std::ostream &out);
+
+ private:
+  struct Readback {
+    std::unique_ptr<LveBuffer> buffer;
+    Frame frame{};
+    int frameIndex = 0;
+    bool pending = false;  // copied on the GPU but not yet delivered
+    bool ready = false;    // the copy has landed
+    LveJobSystem::Counter delivered;
+  };
+
+  Readback &acquireReadback(VkDeviceSize size);
+  void deliverReady();
+  void deliver(Readback &readback);
+  void waitForDelivery(Readback &readback);
+
+  LveDevice &lveDevice;
+  Callback callback;
+  LveJobSystem *jobSystem;
+  uint32_t framesInFlight;
+
+  // twice the frames in flight, so up to framesInFlight delivered frames can wait for the callback
+  // before capture blocks on it
+  std::vector<Readback> readbacks;
+  size_t nextReadback = 0;
+  // in capture order, a ready readback waits for the older ones to keep callbacks in frame order
+  std::deque<Readback *> pendingReadbacks;
+  // the next delivery job is queued after this one
+  Readback *lastDelivered = nullptr;
+  uint64_t nextFrameNumber = 0;
+};
+
+}  // namespace lve
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "lve_camera.hpp"
-#include "lve_game_object.hpp"
+#include "lve_render_snapshot.hpp"
 
 // lib
 #include <vulkan/vulkan.h>
@@ -11,8 +11,8 @@ struct FrameInfo {
   int frameIndex;
   float frameTime;
   VkCommandBuffer commandBuffer;
-  LveCamera &camera;
+  const LveCamera &camera;
   VkDescriptorSet globalDescriptorSet;
-  LveGameObject::Map &gameObjects;
+  const LveRenderSnapshot &snapshot;
 };
 }  // namespace lve
@@ -0,0 +1,100 @@
+#include "lve_frame_pipeline.hpp"
+
+// std
+#include <cassert>
+#include <utility>
+
+namespace lve {
+
+LveFramePipeline::LveFramePipeline(RenderFunction render) : render{std::move(render)} {
+  renderThread = std::thread([this]() { renderLoop(); });
+}
+
+LveFramePipeline::~LveFramePipeline() { stop(); }
+
+LveRenderSnapshot &LveFramePipeline::beginUpdate() {
+  std::unique_lock<std::mutex> lock{mutex};
+  assert(states[updateIndex] != SnapshotState::Updating && "Update already in progress");
+  condition.wait(lock, [this]() {
+    return states[updateIndex] == SnapshotState::Free || renderError != nullptr;
+  });
+  if (renderError) {
+    lock.unlock();
+    rethrowRenderError();
+  }
+
+  states[updateIndex] = SnapshotState::Updating;
+  return snapshots[updateIndex];
+}
+
+void LveFramePipeline::endUpdate() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    assert(states[updateIndex] == SnapshotState::Updating && "No update in progress");
+    states[updateIndex] = SnapshotState::Ready;
+    updateIndex = (updateIndex + 1) % snapshots.size();
+  }
+  condition.notify_all();
+}
+
+void LveFramePipeline::finish() {
+  stop();
+  rethrowRenderError();
+}
+
+void LveFramePipeline::renderLoop() {
+  size_t renderIndex = 0;
+  while (true) {
+    {
+      // frames are handed over in order, so the next one to render is always the oldest
+      std::unique_lock<std::mutex> lock{mutex};
+      condition.wait(lock, [this, renderIndex]() {
+        return states[renderIndex] == SnapshotState::Ready || stopping;
+      });
+      if (states[renderIndex] != SnapshotState::Ready) {
+        return;
+      }
+      states[renderIndex] = SnapshotState::Rendering;
+    }
+
+    try {
+      render(snapshots[renderIndex]);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock{mutex};
+      renderError = std::current_exception();
+      condition.notify_all();
+      return;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      states[renderIndex] = SnapshotState::Free;
+    }
+    condition.notify_all();
+    renderIndex = (renderIndex + 1) % snapshots.size();
+  }
+}
+
+void LveFramePipeline::stop() {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    stopping = true;
+  }
+  condition.notify_all();
+  if (renderThread.joinable()) {
+    renderThread.join();
+  }
+}
+
+void LveFramePipeline::rethrowRenderError() {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    error = renderError;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace lve
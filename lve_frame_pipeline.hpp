@@ -0,0 +1,58 @@
+#pragma once
+
+#include "lve_render_snapshot.hpp"
+
+// std
+#include <array>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace lve {
+
+// Overlaps the simulation of frame N + 1 on the calling thread with the recording and submission
+// of frame N on a render thread. The two stages hand double buffered render snapshots to each
+// other, so only the render thread may use the renderer and render systems while the pipeline
+// runs, and only the calling thread may touch the game objects.
+class LveFramePipeline {
+ public:
+  using RenderFunction = std::function<void(const LveRenderSnapshot &snapshot)>;
+
+  explicit LveFramePipeline(RenderFunction render);
+  ~LveFramePipeline();
+
+  LveFramePipeline(const LveFramePipeline &) = delete;
+  LveFramePipeline &operator=(const LveFramePipeline &) = delete;
+
+  // Returns the snapshot to capture the next frame into, waiting until the render thread is done
+  // with it. Rethrows an exception thrown by the render function.
+  LveRenderSnapshot &beginUpdate();
+  // Hands the snapshot returned by beginUpdate to the render thread
+  void endUpdate();
+
+  // Renders the frames handed over so far, stops the render thread and rethrows an exception
+  // thrown by the render function
+  void finish();
+
+ private:
+  enum class SnapshotState { Free, Updating, Ready, Rendering };
+
+  void renderLoop();
+  void stop();
+  void rethrowRenderError();
+
+  RenderFunction render;
+  std::array<LveRenderSnapshot, 2> snapshots{};
+  std::array<SnapshotState, 2> states{SnapshotState::Free, SnapshotState::Free};
+  size_t updateIndex = 0;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  bool stopping = false;
+  std::exception_ptr renderError;
+  std::thread renderThread;
+};
+
+}  // namespace lve
@@ -0,0 +1,146 @@
+#include "lve_frustum.hpp"
+
+// libs
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// std
+#include <cmath>
+
+namespace lve {
+
+void LveSphereBatch::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  radius.clear();
+}
+
+void LveSphereBatch::add(const glm::vec3 &center, float sphereRadius) {
+  x.push_back(center.x);
+  y.push_back(center.y);
+  z.push_back(center.z);
+  radius.push_back(sphereRadius);
+}
+
+void LveSphereBatch::resize(size_t count) {
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  radius.resize(count);
+}
+
+void LveSphereBatch::set(size_t index, const glm::vec3 &center, float sphereRadius) {
+  x[index] = center.x;
+  y[index] = center.y;
+  z[index] = center.z;
+  radius[index] = sphereRadius;
+}
+
+LveFrustum::LveFrustum(const glm::mat4 &projectionView) {
+  // rows of the matrix, glm is column major
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = {
+        projectionView[0][i],
+        projectionView[1][i],
+        projectionView[2][i],
+        projectionView[3][i]};
+  }
+
+  const glm::vec4 planes[PLANE_COUNT] = {
+      rows[3] + rows[0],  // left
+      rows[3] - rows[0],  // right
+      rows[3] + rows[1],  // bottom
+      rows[3] - rows[1],  // top
+      rows[2],            // near, clip space depth starts at 0
+      rows[3] - rows[2],  // far
+  };
+
+  for (int i = 0; i < PLANE_COUNT; i++) {
+    float length = glm::length(glm::vec3{planes[i]});
+    normalX[i] = planes[i].x / length;
+    normalY[i] = planes[i].y / length;
+    normalZ[i] = planes[i].z / length;
+    distance[i] = planes[i].w / length;
+  }
+}
+
+bool LveFrustum::isSphereVisible(const glm::vec3 &center, float radius) const {
+  for (int i = 0; i < PLANE_COUNT; i++) {
+    float d = normalX[i] * center.x + normalY[i] * center.y + normalZ[i] * center.z + distance[i];
+    if (d < -radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LveFrustum::cullSpheres(const LveSphereBatch &spheres, std::vector<uint8_t> &visible) const {
+  visible.resize(spheres.size());
+  cullSpheres(spheres, 0, spheres.size(), visible.data());
+}
+
+void LveFrustum::cullSpheres(
+    const LveSphereBatch &spheres, size_t first, size_t last, uint8_t *visible) const {
+  size_t i = first;
+
+#if defined(__AVX__)
+  for (; i + 8 <= last; i += 8) {
+    __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+    __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+    __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+    __m256 negRadius =
+        _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius.data() + i));
+
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < PLANE_COUNT; p++) {
+      __m256 d = _mm256_add_ps(
+          _mm256_add_ps(
+              _mm256_mul_ps(x, _mm256_set1_ps(normalX[p])),
+              _mm256_mul_ps(y, _mm256_set1_ps(normalY[p]))),
+          _mm256_add_ps(
+              _mm256_mul_ps(z, _mm256_set1_ps(normalZ[p])),
+              _mm256_set1_ps(distance[p])));
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negRadius, _CMP_GE_OQ));
+    }
+
+    int mask = _mm256_movemask_ps(inside);
+    for (int k = 0; k < 8; k++) {
+      visible[i + k] = (mask >> k) & 1;
+    }
+  }
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+  for (; i + 4 <= last; i += 4) {
+    __m128 x = _mm_loadu_ps(spheres.x.data() + i);
+    __m128 y = _mm_loadu_ps(spheres.y.data() + i);
+    __m128 z = _mm_loadu_ps(spheres.z.data() + i);
+    __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.radius.data() + i));
+
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (int p = 0; p < PLANE_COUNT; p++) {
+      __m128 d = _mm_add_ps(
+          _mm_add_ps(
+              _mm_mul_ps(x, _mm_set1_ps(normalX[p])),
+              _mm_mul_ps(y, _mm_set1_ps(normalY[p]))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(normalZ[p])), _mm_set1_ps(distance[p])));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negRadius));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    for (int k = 0; k < 4; k++) {
+      visible[i + k] = (mask >> k) & 1;
+    }
+  }
+#endif
+
+  for (; i < last; i++) {
+    glm::vec3 center{spheres.x[i], spheres.y[i], spheres.z[i]};
+    visible[i] = isSphereVisible(center, spheres.radius[i]) ? 1 : 0;
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,62 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// Bounding spheres in structure of arrays layout so they can be tested several at a time
+struct LveSphereBatch {
+  std::vector<float> x{};
+  std::vector<float> y{};
+  std::vector<float> z{};
+  std::vector<float> radius{};
+
+  void clear();
+  void add(const glm::vec3 &center, float sphereRadius);
+  void resize(size_t count);
+  void set(size_t index, const glm::vec3 &center, float sphereRadius);
+  size_t size() const { return radius.size(); }
+};
+
+class LveFrustum {
+ public:
+  LveFrustum() = default;
+
+  // Extracts the six planes of a projection * view matrix with depth in [0, 1], planes are
+  // normalized and point inwards
+  explicit LveFrustum(const glm::mat4 &projectionView);
+
+  bool isSphereVisible(const glm::vec3 &center, float radius) const;
+
+  // Plane i as (normal, distance), in the order left, right, bottom, top, near, far
+  glm::vec4 getPlane(int index) const {
+    return {normalX[index], normalY[index], normalZ[index], distance[index]};
+  }
+
+  // Writes 1 to visible[i] when sphere i intersects the frustum and 0 otherwise, 8 or 4 spheres
+  // per iteration depending on the instruction set the engine is built for
+  void cullSpheres(const LveSphereBatch &spheres, std::vector<uint8_t> &visible) const;
+  // Same for spheres [first, last), visible is indexed like spheres and must hold at least last
+  // entries
+  void cullSpheres(
+      const LveSphereBatch &spheres, size_t first, size_t last, uint8_t *visible) const;
+
+ private:
+  static constexpr int PLANE_COUNT = 6;
+
+  // plane components split up as well, each one broadcast once per plane in the SIMD loop
+  std::array<float, PLANE_COUNT> normalX{};
+  std::array<float, PLANE_COUNT> normalY{};
+  std::array<float, PLANE_COUNT> normalZ{};
+  std::array<float, PLANE_COUNT> distance{};
+};
+
+}  // namespace lve
@@ -1,5 +1,11 @@
 #include "lve_game_object.hpp"
 
+#include "lve_transform_batch.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
 namespace lve {
 
 glm::mat4 TransformComponent::mat4() {
@@ -59,4 +65,381 @@ glm::mat3 TransformComponent::normalMatrix() {
   };
 }
 
-}  // namespace lve
\ No newline at end of file
+namespace {
+
+// Reorders values so that values[i] becomes the value previously at order[i]
+template <typename T>
+void permute(std::vector<T> &values, const std::vector<uint32_t> &order) {
+  std::vector<T> reordered{};
+  reordered.reserve(values.size());
+  for (uint32_t oldSlot : order) {
+    reordered.push_back(std::move(values[oldSlot]));
+  }
+  values.swap(reordered);
+}
+
+// dirtyFlags value for slots already gathered by the current update
+constexpr uint8_t DIRTY_GATHERED = 2;
+
+}  // namespace
+
+LveGameObject &LveGameObjectMap::emplace(
+    LveGameObject &&gameObject, const TransformComponent &transform) {
+  id_t id = gameObject.getId();
+  assert(!contains(id) && "Game object already in map");
+  if (id >= slots.size()) {
+    slots.resize(id + 1, INVALID_SLOT);
+  }
+  slots[id] = size();
+
+  objects.push_back(std::move(gameObject));
+  translations.push_back(transform.translation);
+  rotations.push_back(transform.rotation);
+  scales.push_back(transform.scale);
+  parentSlots.push_back(INVALID_SLOT);
+  childCounts.push_back(0);
+  localModelMatrices.emplace_back(1.f);
+  localNormalMatrices.emplace_back(1.f);
+  modelMatrices.emplace_back(1.f);
+  normalMatrices.emplace_back(1.f);
+  matrixVersions.push_back(matrixGeneration);
+  dirtyFlags.push_back(0);
+  markDirty(size() - 1);
+  return objects.back();
+}
+
+void LveGameObjectMap::erase(id_t id) {
+  uint32_t slot = getSlot(id);
+  if (slot == INVALID_SLOT) return;
+
+  if (childCounts[slot] > 0) {
+    for (uint32_t i = 0; i < size(); i++) {
+      if (parentSlots[i] == slot) {
+        parentSlots[i] = INVALID_SLOT;
+        parentedCount--;
+        markDirty(i);
+      }
+    }
+  }
+  if (parentSlots[slot] != INVALID_SLOT) {
+    childCounts[parentSlots[slot]]--;
+    parentedCount--;
+  }
+
+  // keep the arrays dense by moving the last object into the freed slot
+  uint32_t last = size() - 1;
+  if (slot != last) {
+    slots[objects[last].getId()] = slot;
+    objects[slot] = std::move(objects[last]);
+    translations[slot] = translations[last];
+    rotations[slot] = rotations[last];
+    scales[slot] = scales[last];
+    parentSlots[slot] = parentSlots[last];
+    childCounts[slot] = childCounts[last];
+    localModelMatrices[slot] = localModelMatrices[last];
+    localNormalMatrices[slot] = localNormalMatrices[last];
+    modelMatrices[slot] = modelMatrices[last];
+    normalMatrices[slot] = normalMatrices[last];
+
+    if (childCounts[slot] > 0) {
+      for (uint32_t i = 0; i < last; i++) {
+        if (parentSlots[i] == last) {
+          parentSlots[i] = slot;
+        }
+      }
+      // the moved parent may now sit above some of its children
+      hierarchySorted = false;
+    }
+    if (parentSlots[slot] != INVALID_SLOT && parentSlots[slot] > slot) {
+      hierarchySorted = false;
+    }
+
+    // the slot now holds a different object, so copies kept by other systems are stale
+    markDirty(slot);
+  }
+  slots[id] = INVALID_SLOT;
+  if (dirtyFlags[last]) {
+    dirtyFlags[last] = 0;
+    dirtyCount--;
+  }
+
+  objects.pop_back();
+  translations.pop_back();
+  rotations.pop_back();
+  scales.pop_back();
+  parentSlots.pop_back();
+  childCounts.pop_back();
+  localModelMatrices.pop_back();
+  localNormalMatrices.pop_back();
+  modelMatrices.pop_back();
+  normalMatrices.pop_back();
+  matrixVersions.pop_back();
+  dirtyFlags.pop_back();
+}
+
+void LveGameObjectMap::clear() {
+  slots.clear();
+  objects.clear();
+  translations.clear();
+  rotations.clear();
+  scales.clear();
+  parentSlots.clear();
+  childCounts.clear();
+  localModelMatrices.clear();
+  localNormalMatrices.clear();
+  modelMatrices.clear();
+  normalMatrices.clear();
+  matrixVersions.clear();
+  dirtyFlags.clear();
+  dirtySlots.clear();
+  dirtyCount = 0;
+  parentedCount = 0;
+  hierarchySorted = true;
+}
+
+void LveGameObjectMap::setParent(id_t child, id_t parent) {
+  uint32_t childSlot = getSlot(child);
+  assert(childSlot != INVALID_SLOT && "Cannot parent a game object that is not in the map");
+  uint32_t parentSlot = INVALID_SLOT;
+  if (parent != INVALID_ID) {
+    parentSlot = getSlot(parent);
+    assert(parentSlot != INVALID_SLOT && "Cannot parent to a game object that is not in the map");
+  }
+
+  for (uint32_t ancestor = parentSlot; ancestor != INVALID_SLOT; ancestor = parentSlots[ancestor]) {
+    if (ancestor == childSlot) {
+      throw std::runtime_error("cannot parent a game object to itself or its descendants!");
+    }
+  }
+
+  uint32_t oldParentSlot = parentSlots[childSlot];
+  if (oldParentSlot == parentSlot) return;
+  if (oldParentSlot != INVALID_SLOT) {
+    childCounts[oldParentSlot]--;
+    parentedCount--;
+  }
+  if (parentSlot != INVALID_SLOT) {
+    childCounts[parentSlot]++;
+    parentedCount++;
+    if (parentSlot > childSlot) {
+      hierarchySorted = false;
+    }
+  }
+  parentSlots[childSlot] = parentSlot;
+  markDirty(childSlot);
+}
+
+LveGameObjectMap::id_t LveGameObjectMap::getParent(id_t child) const {
+  uint32_t childSlot = getSlot(child);
+  assert(childSlot != INVALID_SLOT && "Game object is not in the map");
+  uint32_t parentSlot = parentSlots[childSlot];
+  return parentSlot == INVALID_SLOT ? INVALID_ID : objects[parentSlot].getId();
+}
+
+TransformComponent LveGameObjectMap::getTransform(uint32_t slot) const {
+  TransformComponent transform{};
+  transform.translation = translations[slot];
+  transform.rotation = rotations[slot];
+  transform.scale = scales[slot];
+  return transform;
+}
+
+void LveGameObjectMap::setTransform(uint32_t slot, const TransformComponent &transform) {
+  translations[slot] = transform.translation;
+  rotations[slot] = transform.rotation;
+  scales[slot] = transform.scale;
+  markDirty(slot);
+}
+
+void LveGameObjectMap::setTranslation(uint32_t slot, const glm::vec3 &translation) {
+  translations[slot] = translation;
+  markDirty(slot);
+}
+
+void LveGameObjectMap::setRotation(uint32_t slot, const glm::vec3 &rotation) {
+  rotations[slot] = rotation;
+  markDirty(slot);
+}
+
+void LveGameObjectMap::setScale(uint32_t slot, const glm::vec3 &scale) {
+  scales[slot] = scale;
+  markDirty(slot);
+}
+
+void LveGameObjectMap::markDirty(uint32_t slot) {
+  if (dirtyFlags[slot]) return;
+  dirtyFlags[slot] = 1;
+  dirtySlots.push_back(slot);
+  dirtyCount++;
+}
+
+void LveGameObjectMap::updateMatrices(LveJobSystem *jobSystem) {
+  matrixGeneration++;
+  if (dirtyCount == 0) {
+    dirtySlots.clear();
+    return;
+  }
+
+  if (!hierarchySorted) {
+    sortHierarchy();
+  }
+  computeLocalMatrices(jobSystem);
+  propagateWorldMatrices();
+  dirtySlots.clear();
+  dirtyCount = 0;
+}
+
+void LveGameObjectMap::computeLocalMatrices(LveJobSystem *jobSystem) {
+  if (dirtyCount == size()) {
+    // everything changed, run the kernel over the arrays in place
+    computeTransformMatrices(
+        jobSystem,
+        translations.data(),
+        rotations.data(),
+        scales.data(),
+        size(),
+        localModelMatrices.data(),
+        localNormalMatrices.data());
+    return;
+  }
+
+  // gather the dirty transforms so the kernel still sees contiguous arrays
+  dirtyTranslations.clear();
+  dirtyRotations.clear();
+  dirtyScales.clear();
+  size_t dirtyEnd = 0;
+  for (uint32_t slot : dirtySlots) {
+    if (slot >= size() || dirtyFlags[slot] != 1) continue;
+    dirtyFlags[slot] = DIRTY_GATHERED;
+    dirtySlots[dirtyEnd++] = slot;
+    dirtyTranslations.push_back(translations[slot]);
+    dirtyRotations.push_back(rotations[slot]);
+    dirtyScales.push_back(scales[slot]);
+  }
+  dirtySlots.resize(dirtyEnd);
+  dirtyModelMatrices.resize(dirtyEnd);
+  dirtyNormalMatrices.resize(dirtyEnd);
+
+  computeTransformMatrices(
+      jobSystem,
+      dirtyTranslations.data(),
+      dirtyRotations.data(),
+      dirtyScales.data(),
+      dirtyEnd,
+      dirtyModelMatrices.data(),
+      dirtyNormalMatrices.data());
+  for (size_t i = 0; i < dirtyEnd; i++) {
+    localModelMatrices[dirtySlots[i]] = dirtyModelMatrices[i];
+    localNormalMatrices[dirtySlots[i]] = dirtyNormalMatrices[i];
+  }
+}
+
+void LveGameObjectMap::propagateWorldMatrices() {
+  if (parentedCount == 0) {
+    // flat scene, world and local matrices are the same
+    for (uint32_t slot = 0; slot < size(); slot++) {
+      if (!dirtyFlags[slot]) continue;
+      dirtyFlags[slot] = 0;
+      modelMatrices[slot] = localModelMatrices[slot];
+      normalMatrices[slot] = localNormalMatrices[slot];
+      matrixVersions[slot] = matrixGeneration;
+    }
+    return;
+  }
+
+  // parents sit in lower slots than their children, so a single pass in slot order sees every
+  // parent's final world matrix before its children and only touches changed subtrees
+  worldChanged.resize(size());
+  for (uint32_t slot = 0; slot < size(); slot++) {
+    uint32_t parentSlot = parentSlots[slot];
+    bool changed = dirtyFlags[slot] || (parentSlot != INVALID_SLOT && worldChanged[parentSlot]);
+    worldChanged[slot] = changed;
+    if (!changed) continue;
+
+    dirtyFlags[slot] = 0;
+    if (parentSlot == INVALID_SLOT) {
+      modelMatrices[slot] = localModelMatrices[slot];
+      normalMatrices[slot] = localNormalMatrices[slot];
+    } else {
+      modelMatrices[slot] = modelMatrices[parentSlot] * localModelMatrices[slot];
+      normalMatrices[slot] = normalMatrices[parentSlot] * localNormalMatrices[slot];
+    }
+    matrixVersions[slot] = matrixGeneration;
+  }
+}
+
+void LveGameObjectMap::sortHierarchy() {
+  // breadth first order with roots first, children grouped by parent with a counting sort
+  const uint32_t count = size();
+  std::vector<uint32_t> childOffsets(count + 1, 0);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    if (parentSlots[slot] != INVALID_SLOT) {
+      childOffsets[parentSlots[slot] + 1]++;
+    }
+  }
+  for (uint32_t slot = 0; slot < count; slot++) {
+    childOffsets[slot + 1] += childOffsets[slot];
+  }
+  std::vector<uint32_t> children(childOffsets[count]);
+  std::vector<uint32_t> childEnds(childOffsets.begin(), childOffsets.end() - 1);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    if (parentSlots[slot] != INVALID_SLOT) {
+      children[childEnds[parentSlots[slot]]++] = slot;
+    }
+  }
+
+  std::vector<uint32_t> order{};
+  order.reserve(count);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    if (parentSlots[slot] == INVALID_SLOT) {
+      order.push_back(slot);
+    }
+  }
+  for (size_t i = 0; i < order.size(); i++) {
+    uint32_t slot = order[i];
+    for (uint32_t c = childOffsets[slot]; c < childOffsets[slot + 1]; c++) {
+      order.push_back(children[c]);
+    }
+  }
+  assert(order.size() == count && "Game object hierarchy contains a cycle");
+
+  std::vector<uint32_t> newSlots(count);
+  for (uint32_t slot = 0; slot < count; slot++) {
+    newSlots[order[slot]] = slot;
+  }
+  for (auto &parentSlot : parentSlots) {
+    if (parentSlot != INVALID_SLOT) {
+      parentSlot = newSlots[parentSlot];
+    }
+  }
+
+  permute(objects, order);
+  permute(translations, order);
+  permute(rotations, order);
+  permute(scales, order);
+  permute(parentSlots, order);
+  permute(childCounts, order);
+  permute(localModelMatrices, order);
+  permute(localNormalMatrices, order);
+  permute(modelMatrices, order);
+  permute(normalMatrices, order);
+  permute(matrixVersions, order);
+  permute(dirtyFlags, order);
+
+  // moved slots hold different objects now, so copies kept by other systems are stale
+  dirtySlots.clear();
+  dirtyCount = 0;
+  for (uint32_t slot = 0; slot < count; slot++) {
+    slots[objects[slot].getId()] = slot;
+    if (order[slot] != slot) {
+      dirtyFlags[slot] = 1;
+    }
+    if (dirtyFlags[slot]) {
+      dirtySlots.push_back(slot);
+      dirtyCount++;
+    }
+  }
+  hierarchySorted = true;
+}
+
+}  // namespace lve
@@ -1,13 +1,15 @@
 #pragma once
 
+#include "lve_job_system.hpp"
 #include "lve_model.hpp"
 
 // libs
 #include <glm/gtc/matrix_transform.hpp>
 
 // std
+#include <cstdint>
 #include <memory>
-#include <unordered_map>
+#include <vector>
 
 namespace lve {
 
@@ -24,10 +26,12 @@ struct TransformComponent {
   glm::mat3 normalMatrix();
 };
 
+class LveGameObjectMap;
+
 class LveGameObject {
  public:
   using id_t = unsigned int;
-  using Map = std::unordered_map<id_t, LveGameObject>;
+  using Map = LveGameObjectMap;
 
   static LveGameObject createGameObject() {
     static id_t currentId = 0;
@@ -39,15 +43,109 @@ class LveGameObject {
   LveGameObject(LveGameObject &&) = default;
   LveGameObject &operator=(LveGameObject &&) = default;
 
-  id_t getId() { return id; }
+  id_t getId() const { return id; }
 
   std::shared_ptr<LveModel> model{};
   glm::vec3 color{};
-  TransformComponent transform{};
 
  private:
   LveGameObject(id_t objId) : id{objId} {}
 
   id_t id;
 };
+
+// Stores game objects densely, with their transforms split into parallel translation, rotation
+// and scale arrays so systems can walk them linearly. Ids map to dense slots through a sparse
+// array. Slots and object references are only stable until the next emplace, erase, setParent or
+// updateMatrices call: erase moves the last object into the freed slot, and the arrays are
+// reordered when needed to keep every parent in a lower slot than its children.
+class LveGameObjectMap {
+ public:
+  using id_t = LveGameObject::id_t;
+  static constexpr uint32_t INVALID_SLOT = UINT32_MAX;
+  static constexpr id_t INVALID_ID = UINT32_MAX;
+
+  LveGameObject &emplace(LveGameObject &&gameObject, const TransformComponent &transform = {});
+  // Children of an erased object become roots and keep their local transform
+  void erase(id_t id);
+  void clear();
+
+  bool contains(id_t id) const { return getSlot(id) != INVALID_SLOT; }
+  uint32_t getSlot(id_t id) const { return id < slots.size() ? slots[id] : INVALID_SLOT; }
+  uint32_t size() const { return static_cast<uint32_t>(objects.size()); }
+  bool empty() const { return objects.empty(); }
+
+  LveGameObject &getObject(uint32_t slot) { return objects[slot]; }
+  const LveGameObject &getObject(uint32_t slot) const { return objects[slot]; }
+
+  // Makes child's transform relative to parent, or to the world when parent is INVALID_ID. The
+  // local transform is kept, so the child moves with its new parent from the next update.
+  void setParent(id_t child, id_t parent);
+  id_t getParent(id_t child) const;
+
+  // Local transforms, relative to the parent when there is one
+  TransformComponent getTransform(uint32_t slot) const;
+  void setTransform(uint32_t slot, const TransformComponent &transform);
+  void setTranslation(uint32_t slot, const glm::vec3 &translation);
+  void setRotation(uint32_t slot, const glm::vec3 &rotation);
+  void setScale(uint32_t slot, const glm::vec3 &scale);
+
+  const std::vector<glm::vec3> &getTranslations() const { return translations; }
+  const std::vector<glm::vec3> &getRotations() const { return rotations; }
+  const std::vector<glm::vec3> &getScales() const { return scales; }
+  bool isDirty(uint32_t slot) const { return dirtyFlags[slot] != 0; }
+
+  // Rebuilds the local matrices of slots whose transform changed since the last call and the world
+  // matrices of those slots and their descendants. Call once per frame after transforms have been
+  // updated and before the matrices are read. With a job system the local matrices are computed
+  // in parallel.
+  void updateMatrices(LveJobSystem *jobSystem = nullptr);
+  void markDirty(uint32_t slot);
+
+  // World space matrices
+  const glm::mat4 &getModelMatrix(uint32_t slot) const { return modelMatrices[slot]; }
+  const glm::mat3 &getNormalMatrix(uint32_t slot) const { return normalMatrices[slot]; }
+
+  // Incremented by every updateMatrices call. A slot's matrix version is the generation in which
+  // its world matrices last changed, so systems keeping their own copies can refresh only those
+  // slots.
+  uint64_t getMatrixGeneration() const { return matrixGeneration; }
+  uint64_t getMatrixVersion(uint32_t slot) const { return matrixVersions[slot]; }
+
+ private:
+  void computeLocalMatrices(LveJobSystem *jobSystem);
+  void propagateWorldMatrices();
+  void sortHierarchy();
+
+  std::vector<uint32_t> slots;  // indexed by id
+
+  // dense, indexed by slot
+  std::vector<LveGameObject> objects;
+  std::vector<glm::vec3> translations;
+  std::vector<glm::vec3> rotations;
+  std::vector<glm::vec3> scales;
+  std::vector<uint32_t> parentSlots;
+  std::vector<uint32_t> childCounts;
+  std::vector<glm::mat4> localModelMatrices;
+  std::vector<glm::mat3> localNormalMatrices;
+  std::vector<glm::mat4> modelMatrices;
+  std::vector<glm::mat3> normalMatrices;
+  std::vector<uint64_t> matrixVersions;
+  std::vector<uint8_t> dirtyFlags;
+  std::vector<uint8_t> worldChanged;  // scratch for propagateWorldMatrices
+
+  // may hold slots that were erased or already cleaned, dirtyFlags is authoritative
+  std::vector<uint32_t> dirtySlots;
+  uint32_t dirtyCount = 0;
+  uint32_t parentedCount = 0;
+  bool hierarchySorted = true;
+  uint64_t matrixGeneration = 0;
+
+  // gather buffers for updating a subset of slots
+  std::vector<glm::vec3> dirtyTranslations;
+  std::vector<glm::vec3> dirtyRotations;
+  std::vector<glm::vec3> dirtyScales;
+  std::vector<glm::mat4> dirtyModelMatrices;
+  std::vector<glm::mat3> dirtyNormalMatrices;
+};
 }  // namespace lve
@@ -0,0 +1,77 @@
+#include "lve_geometry_pool.hpp"
+
+#include "lve_transfer_manager.hpp"
+
+namespace lve {
+
+LveGeometryPool::LveGeometryPool(
+    LveDevice &device, VkDeviceSize vertexStride, uint32_t vertexCapacity, uint32_t indexCapacity)
+    : lveDevice{device},
+      vertexStride{vertexStride},
+      vertexRanges{vertexCapacity},
+      indexRanges{indexCapacity} {
+  vertexBuffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      vertexStride,
+      vertexCapacity,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+  indexBuffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      sizeof(uint32_t),
+      indexCapacity,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+bool LveGeometryPool::allocate(
+    const void *vertices,
+    uint32_t vertexCount,
+    const uint32_t *indices,
+    uint32_t indexCount,
+    Allocation &allocation) {
+  uint64_t firstVertex;
+  if (!vertexRanges.allocate(vertexCount, 1, allocation.vertexRange, firstVertex)) {
+    return false;
+  }
+
+  uint64_t firstIndex = 0;
+  if (indexCount > 0 && !indexRanges.allocate(indexCount, 1, allocation.indexRange, firstIndex)) {
+    vertexRanges.free(allocation.vertexRange);
+    return false;
+  }
+
+  allocation.vertexOffset = static_cast<int32_t>(firstVertex);
+  allocation.firstIndex = static_cast<uint32_t>(firstIndex);
+
+  auto &transferManager = lveDevice.transferManager();
+  transferManager.uploadToBuffer(
+      vertexBuffer->getBuffer(),
+      vertices,
+      vertexStride * vertexCount,
+      vertexStride * firstVertex);
+  if (indexCount > 0) {
+    transferManager.uploadToBuffer(
+        indexBuffer->getBuffer(),
+        indices,
+        sizeof(uint32_t) * indexCount,
+        sizeof(uint32_t) * firstIndex);
+  }
+  return true;
+}
+
+void LveGeometryPool::free(const Allocation &allocation) {
+  vertexRanges.free(allocation.vertexRange);
+  if (allocation.indexRange.size > 0) {
+    indexRanges.free(allocation.indexRange);
+  }
+}
+
+void LveGeometryPool::bind(VkCommandBuffer commandBuffer) {
+  VkBuffer buffers[] = {vertexBuffer->getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+}
+
+}  // namespace lve
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+#include "lve_range_allocator.hpp"
+
+// std
+#include <memory>
+
+namespace lve {
+
+// One device local vertex buffer and one index buffer shared by many models, so consecutive draws
+// of pooled models need a single bind and only differ in their offsets
+class LveGeometryPool {
+ public:
+  static constexpr uint32_t DEFAULT_VERTEX_CAPACITY = 1 << 20;
+  static constexpr uint32_t DEFAULT_INDEX_CAPACITY = 4 << 20;
+
+  // The geometry of one model inside the pool
+  struct Allocation {
+    int32_t vertexOffset = 0;
+    uint32_t firstIndex = 0;
+    LveRangeAllocator::Range vertexRange{};
+    LveRangeAllocator::Range indexRange{};
+  };
+
+  LveGeometryPool(
+      LveDevice &device,
+      VkDeviceSize vertexStride,
+      uint32_t vertexCapacity = DEFAULT_VERTEX_CAPACITY,
+      uint32_t indexCapacity = DEFAULT_INDEX_CAPACITY);
+
+  LveGeometryPool(const LveGeometryPool &) = delete;
+  LveGeometryPool &operator=(const LveGeometryPool &) = delete;
+
+  // Reserves room for the geometry and uploads it through the device's transfer manager. Returns
+  // false, leaving the pool untouched, when either buffer has no range large enough.
+  bool allocate(
+      const void *vertices,
+      uint32_t vertexCount,
+      const uint32_t *indices,
+      uint32_t indexCount,
+      Allocation &allocation);
+
+  // The GPU must be done with the geometry, as with destroying a buffer
+  void free(const Allocation &allocation);
+
+  void bind(VkCommandBuffer commandBuffer);
+
+  VkBuffer getVertexBuffer() const { return vertexBuffer->getBuffer(); }
+  VkBuffer getIndexBuffer() const { return indexBuffer->getBuffer(); }
+
+ private:
+  LveDevice &lveDevice;
+  VkDeviceSize vertexStride;
+
+  std::unique_ptr<LveBuffer> vertexBuffer;
+  std::unique_ptr<LveBuffer> indexBuffer;
+  LveRangeAllocator vertexRanges;
+  LveRangeAllocator indexRanges;
+};
+
+}  // namespace lve
@@ -0,0 +1,199 @@
+#include "lve_job_system.hpp"
+
+namespace lve {
+
+namespace {
+
+// identifies the worker the current thread runs for, if any
+thread_local const LveJobSystem *currentJobSystem = nullptr;
+thread_local size_t currentQueueIndex = 0;
+
+}  // namespace
+
+bool LveJobSystem::Counter::isDone() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return pendingJobs == 0;
+}
+
+unsigned int LveJobSystem::getDefaultWorkerCount() {
+  // hardware_concurrency may report 0 when the core count is unknown
+  unsigned int coreCount = std::thread::hardware_concurrency();
+  return std::max(coreCount, 2u) - 1;
+}
+
+LveJobSystem::LveJobSystem(unsigned int workerCount) {
+  queues.reserve(workerCount + 1);
+  for (unsigned int i = 0; i <= workerCount; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  workers.reserve(workerCount);
+  for (unsigned int i = 0; i < workerCount; i++) {
+    workers.emplace_back([this, i]() { workerLoop(i + 1); });
+  }
+}
+
+LveJobSystem::~LveJobSystem() {
+  {
+    std::lock_guard<std::mutex> lock{sleepMutex};
+    stopping = true;
+  }
+  condition.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void LveJobSystem::run(std::function<void()> job, Counter *counter, Priority priority) {
+  if (counter != nullptr) {
+    std::lock_guard<std::mutex> lock{counter->mutex};
+    counter->pendingJobs++;
+  }
+  push(Job{std::move(job), counter, priority});
+}
+
+void LveJobSystem::runAfter(
+    Counter &dependency, std::function<void()> job, Counter *counter, Priority priority) {
+  if (counter != nullptr) {
+    std::lock_guard<std::mutex> lock{counter->mutex};
+    counter->pendingJobs++;
+  }
+
+  {
+    // finish takes the continuations under the same lock, so none can be missed
+    std::lock_guard<std::mutex> lock{dependency.mutex};
+    if (dependency.pendingJobs > 0) {
+      dependency.continuations.push_back(Job{std::move(job), counter, priority});
+      return;
+    }
+  }
+  push(Job{std::move(job), counter, priority});
+}
+
+void LveJobSystem::wait(Counter &counter) {
+  // running a background job here could hold up the frame the caller is waiting for, without
+  // workers nobody else would run it though
+  size_t queueIndex = getQueueIndex();
+  bool takeBackground = workers.empty();
+  while (!counter.isDone()) {
+    if (!tryRunJob(queueIndex, takeBackground)) {
+      // the remaining jobs are running elsewhere
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr exception;
+  {
+    std::lock_guard<std::mutex> lock{counter.mutex};
+    std::swap(exception, counter.exception);
+  }
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void LveJobSystem::workerLoop(size_t queueIndex) {
+  currentJobSystem = this;
+  currentQueueIndex = queueIndex;
+
+  while (true) {
+    if (tryRunJob(queueIndex, true)) continue;
+
+    std::unique_lock<std::mutex> lock{sleepMutex};
+    condition.wait(lock, [this]() { return stopping || queuedJobs.load() > 0; });
+    if (stopping && queuedJobs.load() == 0) {
+      return;
+    }
+  }
+}
+
+size_t LveJobSystem::getQueueIndex() const {
+  return currentJobSystem == this ? currentQueueIndex : 0;
+}
+
+void LveJobSystem::push(Job job) {
+  auto &queue =
+      job.priority == Priority::Background ? backgroundQueue : *queues[getQueueIndex()];
+  {
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    queue.jobs.push_back(std::move(job));
+  }
+
+  queuedJobs.fetch_add(1);
+  {
+    // a worker checks queuedJobs under this lock before sleeping, so the wake up can't be lost
+    std::lock_guard<std::mutex> lock{sleepMutex};
+  }
+  condition.notify_one();
+}
+
+bool LveJobSystem::pop(size_t queueIndex, bool takeBackground, Job &job) {
+  // newest own job first while it is still hot in cache, then steal the oldest from the others
+  for (size_t i = 0; i < queues.size(); i++) {
+    auto &queue = *queues[(queueIndex + i) % queues.size()];
+    std::lock_guard<std::mutex> lock{queue.mutex};
+    if (queue.jobs.empty()) continue;
+
+    if (i == 0) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    } else {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    }
+    queuedJobs.fetch_sub(1);
+    return true;
+  }
+  if (!takeBackground) return false;
+
+  // oldest first, so background work finishes in the order it was queued
+  std::lock_guard<std::mutex> lock{backgroundQueue.mutex};
+  if (backgroundQueue.jobs.empty()) return false;
+  job = std::move(backgroundQueue.jobs.front());
+  backgroundQueue.jobs.pop_front();
+  queuedJobs.fetch_sub(1);
+  return true;
+}
+
+bool LveJobSystem::tryRunJob(size_t queueIndex, bool takeBackground) {
+  Job job{};
+  if (!pop(queueIndex, takeBackground, job)) {
+    return false;
+  }
+  execute(job);
+  return true;
+}
+
+void LveJobSystem::execute(Job &job) {
+  try {
+    job.function();
+  } catch (...) {
+    if (job.counter == nullptr) {
+      std::terminate();
+    }
+    std::lock_guard<std::mutex> lock{job.counter->mutex};
+    if (!job.counter->exception) {
+      job.counter->exception = std::current_exception();
+    }
+  }
+  finish(job.counter);
+}
+
+void LveJobSystem::finish(Counter *counter) {
+  if (counter == nullptr) return;
+
+  std::vector<Job> continuations;
+  {
+    std::lock_guard<std::mutex> lock{counter->mutex};
+    if (--counter->pendingJobs == 0) {
+      continuations.swap(counter->continuations);
+    }
+  }
+
+  // counter may already be destroyed by its waiter, only the moved out jobs are used from here
+  for (auto &continuation : continuations) {
+    push(std::move(continuation));
+  }
+}
+
+}  // namespace lve
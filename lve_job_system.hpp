@@ -0,0 +1,163 @@
+#pragma once
+
+// std
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lve {
+
+// Work stealing job scheduler shared by the engine subsystems. Every worker owns a deque it pushes
+// to and pops from at the back, idle workers steal from the front of the others. Threads that are
+// not workers, such as the main thread, share one more deque and run jobs while they wait.
+// Background jobs have a queue of their own that only idle workers take from.
+class LveJobSystem {
+ public:
+  enum class Priority {
+    Normal,      // frame work, also run by threads waiting on a counter
+    Background,  // long running work such as pipeline compiles or file writes, only run by idle
+                 // workers, so a wait inside the frame can't stall on it
+  };
+
+  class Counter;
+
+ private:
+  struct Job {
+    std::function<void()> function;
+    Counter *counter = nullptr;
+    Priority priority = Priority::Normal;
+  };
+
+ public:
+  // Counts the jobs of a group until they have finished. A counter must outlive its jobs, it can
+  // be destroyed once wait has returned.
+  class Counter {
+   public:
+    Counter() = default;
+    ~Counter() = default;
+
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    bool isDone();
+
+   private:
+    friend class LveJobSystem;
+
+    std::mutex mutex;
+    size_t pendingJobs = 0;
+    std::exception_ptr exception;
+    // jobs queued by runAfter, started once pendingJobs drops to zero
+    std::vector<Job> continuations;
+  };
+
+  // One worker per core besides the calling thread, which takes part by waiting
+  static unsigned int getDefaultWorkerCount();
+
+  explicit LveJobSystem(unsigned int workerCount = getDefaultWorkerCount());
+  ~LveJobSystem();
+
+  LveJobSystem(const LveJobSystem &) = delete;
+  LveJobSystem &operator=(const LveJobSystem &) = delete;
+
+  // Queues job on the calling thread's deque, or on the background queue. An exception thrown by
+  // the job is rethrown by wait on counter, jobs without a counter must not throw.
+  void run(
+      std::function<void()> job,
+      Counter *counter = nullptr,
+      Priority priority = Priority::Normal);
+
+  // Queues job once dependency has reached zero, even if one of its jobs threw. counter counts
+  // the job from now on, so waiting on it also waits for dependency.
+  void runAfter(
+      Counter &dependency,
+      std::function<void()> job,
+      Counter *counter = nullptr,
+      Priority priority = Priority::Normal);
+
+  // Runs queued normal priority jobs on the calling thread until counter reaches zero, then
+  // rethrows the first exception thrown by one of its jobs. Background jobs are left to the
+  // workers, unless there are none.
+  void wait(Counter &counter);
+
+  // Calls function(begin, end) for consecutive ranges of at most grainSize indices covering
+  // [0, count) and waits for all of them. The first range runs on the calling thread.
+  template <typename F>
+  void parallelFor(size_t count, size_t grainSize, F &&function) {
+    if (count == 0) return;
+    grainSize = std::max<size_t>(grainSize, 1);
+
+    Counter counter{};
+    for (size_t begin = grainSize; begin < count; begin += grainSize) {
+      size_t end = std::min(begin + grainSize, count);
+      run([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+
+    // the queued ranges reference function and counter, let them finish before rethrowing
+    std::exception_ptr exception;
+    try {
+      function(size_t{0}, std::min(grainSize, count));
+    } catch (...) {
+      exception = std::current_exception();
+    }
+    try {
+      wait(counter);
+    } catch (...) {
+      if (!exception) exception = std::current_exception();
+    }
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+
+  // Runs task as a job and returns its result, or its exception, through a future. Blocking on
+  // the future does not run other jobs, wait on counter first to take part in the work.
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F &&task, Counter *counter = nullptr) {
+    using R = std::invoke_result_t<F>;
+    auto packagedTask = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+    std::future<R> result = packagedTask->get_future();
+    run([packagedTask]() { (*packagedTask)(); }, counter);
+    return result;
+  }
+
+  unsigned int getWorkerCount() const { return static_cast<unsigned int>(workers.size()); }
+
+ private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  void workerLoop(size_t queueIndex);
+  size_t getQueueIndex() const;
+  void push(Job job);
+  bool pop(size_t queueIndex, bool takeBackground, Job &job);
+  bool tryRunJob(size_t queueIndex, bool takeBackground);
+  void execute(Job &job);
+  void finish(Counter *counter);
+
+  // queue 0 belongs to threads outside the system, queue i + 1 to worker i
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  // shared by every thread, taken from only once the queues above are empty
+  WorkQueue backgroundQueue;
+  std::vector<std::thread> workers;
+
+  std::atomic<size_t> queuedJobs{0};
+  std::mutex sleepMutex;
+  std::condition_variable condition;
+  bool stopping = false;
+};
+
+}  // namespace lve
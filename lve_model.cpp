@@ -1,5 +1,6 @@
 #include "lve_model.hpp"
 
+#include "lve_transfer_manager.hpp"
 #include "lve_utils.hpp"
 
 // libs
@@ -9,10 +10,26 @@
 #include <glm/gtx/hash.hpp>
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
 #include <unordered_map>
 
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace std {
 template <>
 struct hash<lve::LveModel::Vertex> {
@@ -26,37 +43,216 @@ struct hash<lve::LveModel::Vertex> {
 
 namespace lve {
 
-LveModel::LveModel(LveDevice &device, const LveModel::Builder &builder) : lveDevice{device} {
+namespace {
+
+// Binary mesh cache layout: MeshCacheHeader, vertexCount packed Vertex structs, then indexCount
+// uint32_t indices. The cache is only used when the source file size and modification time match.
+constexpr char MESH_CACHE_MAGIC[4] = {'L', 'V', 'E', 'M'};
+constexpr uint32_t MESH_CACHE_VERSION = 1;
+constexpr const char *MESH_CACHE_EXTENSION = ".lvemesh";
+
+struct MeshCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vertexStride;
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint32_t reserved;
+  uint64_t sourceSize;
+  int64_t sourceModifiedTime;
+};
+
+// Read only view of a whole file, memory mapped where the platform allows it
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &filepath) {
+#ifdef _WIN32
+    std::ifstream file{filepath, std::ios::binary};
+    if (file.is_open()) {
+      contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+      data_ = contents.data();
+      size_ = contents.size();
+    }
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat fileStat {};
+    if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0) {
+      void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        data_ = static_cast<const char *>(mapping);
+        size_ = static_cast<size_t>(fileStat.st_size);
+      }
+    }
+    close(fd);
+#endif
+  }
+
+  ~MappedFile() {
+#ifndef _WIN32
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  std::vector<char> contents;
+#endif
+};
+
+bool makeMeshCacheHeader(const std::string &filepath, MeshCacheHeader &header) {
+  std::error_code ec;
+  auto sourceSize = std::filesystem::file_size(filepath, ec);
+  if (ec) return false;
+  auto sourceModifiedTime = std::filesystem::last_write_time(filepath, ec);
+  if (ec) return false;
+
+  header = {};
+  std::memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+  header.version = MESH_CACHE_VERSION;
+  header.vertexStride = sizeof(LveModel::Vertex);
+  header.sourceSize = static_cast<uint64_t>(sourceSize);
+  header.sourceModifiedTime =
+      static_cast<int64_t>(sourceModifiedTime.time_since_epoch().count());
+  return true;
+}
+
+bool readMeshCache(
+    const std::string &cachePath,
+    const MeshCacheHeader &expected,
+    std::vector<LveModel::Vertex> &vertices,
+    std::vector<uint32_t> &indices) {
+  MappedFile file{cachePath};
+  if (file.data() == nullptr || file.size() < sizeof(MeshCacheHeader)) {
+    return false;
+  }
+
+  MeshCacheHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+  if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+      header.version != expected.version || header.vertexStride != expected.vertexStride ||
+      header.sourceSize != expected.sourceSize ||
+      header.sourceModifiedTime != expected.sourceModifiedTime) {
+    return false;
+  }
+
+  size_t verticesSize = sizeof(LveModel::Vertex) * header.vertexCount;
+  size_t indicesSize = sizeof(uint32_t) * header.indexCount;
+  if (file.size() != sizeof(MeshCacheHeader) + verticesSize + indicesSize) {
+    return false;
+  }
+
+  const char *payload = file.data() + sizeof(MeshCacheHeader);
+  vertices.resize(header.vertexCount);
+  std::memcpy(vertices.data(), payload, verticesSize);
+  indices.resize(header.indexCount);
+  std::memcpy(indices.data(), payload + verticesSize, indicesSize);
+  return true;
+}
+
+void writeMeshCache(
+    const std::string &cachePath,
+    MeshCacheHeader header,
+    const std::vector<LveModel::Vertex> &vertices,
+    const std::vector<uint32_t> &indices) {
+  header.vertexCount = static_cast<uint32_t>(vertices.size());
+  header.indexCount = static_cast<uint32_t>(indices.size());
+
+  // write to a temporary file first so a concurrent or interrupted run never sees a partial cache,
+  // the thread id keeps loader threads writing the same cache from sharing a temporary file
+  const std::string tempPath =
+      cachePath + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) +
+      ".tmp";
+  {
+    std::ofstream file{tempPath, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+      return;  // the cache is an optimization only, e.g. the models directory may be read only
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(
+        reinterpret_cast<const char *>(vertices.data()),
+        sizeof(LveModel::Vertex) * vertices.size());
+    file.write(reinterpret_cast<const char *>(indices.data()), sizeof(uint32_t) * indices.size());
+    if (!file.good()) {
+      file.close();
+      std::remove(tempPath.c_str());
+      return;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tempPath, cachePath, ec);
+  if (ec) {
+    std::remove(tempPath.c_str());
+  }
+}
+
+}  // namespace
+
+LveModel::LveModel(
+    LveDevice &device, const LveModel::Builder &builder, LveGeometryPool *geometryPool)
+    : lveDevice{device}, bounds{builder.bounds} {
+  vertexCount = static_cast<uint32_t>(builder.vertices.size());
+  indexCount = static_cast<uint32_t>(builder.indices.size());
+  hasIndexBuffer = indexCount > 0;
+
+  // fall back to dedicated buffers once the pool is full
+  if (geometryPool != nullptr &&
+      geometryPool->allocate(
+          builder.vertices.data(),
+          vertexCount,
+          builder.indices.data(),
+          indexCount,
+          geometryAllocation)) {
+    this->geometryPool = geometryPool;
+    return;
+  }
+
   createVertexBuffers(builder.vertices);
   createIndexBuffers(builder.indices);
 }
 
-LveModel::~LveModel() {}
+LveModel::~LveModel() {
+  if (geometryPool != nullptr) {
+    geometryPool->free(geometryAllocation);
+  }
+}
 
 std::unique_ptr<LveModel> LveModel::createModelFromFile(
-    LveDevice &device, const std::string &filepath) {
+    LveDevice &device, const std::string &filepath, LveGeometryPool *geometryPool) {
   Builder builder{};
   builder.loadModel(filepath);
-  return std::make_unique<LveModel>(device, builder);
+  return std::make_unique<LveModel>(device, builder, geometryPool);
+}
+
+std::vector<std::unique_ptr<LveModel>> LveModel::createModels(
+    LveDevice &device, const std::vector<Builder> &builders, LveGeometryPool *geometryPool) {
+  std::vector<std::unique_ptr<LveModel>> models{};
+  models.reserve(builders.size());
+  for (const auto &builder : builders) {
+    models.push_back(std::make_unique<LveModel>(device, builder, geometryPool));
+  }
+  device.transferManager().submit();
+
+  return models;
 }
 
 void LveModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
-  vertexCount = static_cast<uint32_t>(vertices.size());
   assert(vertexCount >= 3 && "Vertex count must be at least 3");
   VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
   uint32_t vertexSize = sizeof(vertices[0]);
 
-  LveBuffer stagingBuffer{
-      lveDevice,
-      vertexSize,
-      vertexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)vertices.data());
-
   vertexBuffer = std::make_unique<LveBuffer>(
       lveDevice,
       vertexSize,
@@ -64,13 +260,13 @@ void LveModel::createVertexBuffers(const std::vector<Vertex> &vertices) {
       VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+  lveDevice.transferManager().uploadToBuffer(
+      vertexBuffer->getBuffer(),
+      vertices.data(),
+      bufferSize);
 }
 
 void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
-  indexCount = static_cast<uint32_t>(indices.size());
-  hasIndexBuffer = indexCount > 0;
-
   if (!hasIndexBuffer) {
     return;
   }
@@ -78,17 +274,6 @@ void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
   VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
   uint32_t indexSize = sizeof(indices[0]);
 
-  LveBuffer stagingBuffer{
-      lveDevice,
-      indexSize,
-      indexCount,
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-  };
-
-  stagingBuffer.map();
-  stagingBuffer.writeToBuffer((void *)indices.data());
-
   indexBuffer = std::make_unique<LveBuffer>(
       lveDevice,
       indexSize,
@@ -96,18 +281,58 @@ void LveModel::createIndexBuffers(const std::vector<uint32_t> &indices) {
       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-  lveDevice.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+  lveDevice.transferManager().uploadToBuffer(indexBuffer->getBuffer(), indices.data(), bufferSize);
 }
 
-void LveModel::draw(VkCommandBuffer commandBuffer) {
+void LveModel::draw(
+    VkCommandBuffer commandBuffer, uint32_t instanceCount, uint32_t firstInstance) {
   if (hasIndexBuffer) {
-    vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
+    vkCmdDrawIndexed(
+        commandBuffer,
+        indexCount,
+        instanceCount,
+        geometryAllocation.firstIndex,
+        geometryAllocation.vertexOffset,
+        firstInstance);
   } else {
-    vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+    vkCmdDraw(
+        commandBuffer,
+        vertexCount,
+        instanceCount,
+        static_cast<uint32_t>(geometryAllocation.vertexOffset),
+        firstInstance);
   }
 }
 
+VkDrawIndexedIndirectCommand LveModel::getIndirectCommand(
+    uint32_t instanceCount, uint32_t firstInstance) const {
+  assert(hasIndexBuffer && "Indirect commands are only built for indexed models");
+  VkDrawIndexedIndirectCommand command{};
+  command.indexCount = indexCount;
+  command.instanceCount = instanceCount;
+  command.firstIndex = geometryAllocation.firstIndex;
+  command.vertexOffset = geometryAllocation.vertexOffset;
+  command.firstInstance = firstInstance;
+  return command;
+}
+
+VkDrawIndirectCommand LveModel::getNonIndexedIndirectCommand(
+    uint32_t instanceCount, uint32_t firstInstance) const {
+  assert(!hasIndexBuffer && "Indexed models must use getIndirectCommand");
+  VkDrawIndirectCommand command{};
+  command.vertexCount = vertexCount;
+  command.instanceCount = instanceCount;
+  command.firstVertex = static_cast<uint32_t>(geometryAllocation.vertexOffset);
+  command.firstInstance = firstInstance;
+  return command;
+}
+
 void LveModel::bind(VkCommandBuffer commandBuffer) {
+  if (geometryPool != nullptr) {
+    geometryPool->bind(commandBuffer);
+    return;
+  }
+
   VkBuffer buffers[] = {vertexBuffer->getBuffer()};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
@@ -137,6 +362,40 @@ std::vector<VkVertexInputAttributeDescription> LveModel::Vertex::getAttributeDes
 }
 
 void LveModel::Builder::loadModel(const std::string &filepath) {
+  const std::string cachePath = filepath + MESH_CACHE_EXTENSION;
+  MeshCacheHeader header;
+  if (!makeMeshCacheHeader(filepath, header)) {
+    loadObjModel(filepath);
+  } else if (!readMeshCache(cachePath, header, vertices, indices)) {
+    loadObjModel(filepath);
+    writeMeshCache(cachePath, header, vertices, indices);
+  }
+  computeBounds();
+}
+
+void LveModel::Builder::computeBounds() {
+  bounds = Bounds{};
+  if (vertices.empty()) {
+    return;
+  }
+
+  bounds.min = bounds.max = vertices[0].position;
+  for (const auto &vertex : vertices) {
+    bounds.min = glm::min(bounds.min, vertex.position);
+    bounds.max = glm::max(bounds.max, vertex.position);
+  }
+
+  // a second pass around the box center gives a tighter sphere than the half diagonal
+  bounds.center = (bounds.min + bounds.max) * .5f;
+  float radiusSquared = 0.f;
+  for (const auto &vertex : vertices) {
+    glm::vec3 offset = vertex.position - bounds.center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  bounds.radius = std::sqrt(radiusSquared);
+}
+
+void LveModel::Builder::loadObjModel(const std::string &filepath) {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
@@ -2,6 +2,7 @@
 
 #include "lve_buffer.hpp"
 #include "lve_device.hpp"
+#include "lve_geometry_pool.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -10,6 +11,7 @@
 
 // std
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace lve {
@@ -30,24 +32,61 @@ class LveModel {
     }
   };
 
+  // Model space bounding volumes
+  struct Bounds {
+    glm::vec3 min{0.f};
+    glm::vec3 max{0.f};
+    glm::vec3 center{0.f};  // sphere center, the middle of the box
+    float radius = 0.f;
+  };
+
   struct Builder {
     std::vector<Vertex> vertices{};
     std::vector<uint32_t> indices{};
+    Bounds bounds{};
 
+    // Loads from the binary mesh cache next to filepath when it is up to date, otherwise parses
+    // the OBJ file and (re)writes the cache. Bounds are computed either way.
     void loadModel(const std::string &filepath);
+    void loadObjModel(const std::string &filepath);
+
+    // Must be called after filling vertices by hand
+    void computeBounds();
   };
 
-  LveModel(LveDevice &device, const LveModel::Builder &builder);
+  // The buffer contents are uploaded through the device's transfer manager, which submits them
+  // before the next frame is recorded. With a geometryPool the model is placed in the pool's
+  // shared buffers when it fits, and gets buffers of its own otherwise.
+  LveModel(
+      LveDevice &device,
+      const LveModel::Builder &builder,
+      LveGeometryPool *geometryPool = nullptr);
   ~LveModel();
 
   LveModel(const LveModel &) = delete;
   LveModel &operator=(const LveModel &) = delete;
 
   static std::unique_ptr<LveModel> createModelFromFile(
-      LveDevice &device, const std::string &filepath);
+      LveDevice &device, const std::string &filepath, LveGeometryPool *geometryPool = nullptr);
+
+  // Uploads all builders in one transfer batch and submits it
+  static std::vector<std::unique_ptr<LveModel>> createModels(
+      LveDevice &device,
+      const std::vector<Builder> &builders,
+      LveGeometryPool *geometryPool = nullptr);
 
+  // Binds the pool's buffers for pooled models, which stay valid for every model in that pool
   void bind(VkCommandBuffer commandBuffer);
-  void draw(VkCommandBuffer commandBuffer);
+  void draw(
+      VkCommandBuffer commandBuffer, uint32_t instanceCount = 1, uint32_t firstInstance = 0);
+
+  LveGeometryPool *getGeometryPool() const { return geometryPool; }
+  const Bounds &getBounds() const { return bounds; }
+  bool isIndexed() const { return hasIndexBuffer; }
+  VkDrawIndexedIndirectCommand getIndirectCommand(
+      uint32_t instanceCount, uint32_t firstInstance) const;
+  VkDrawIndirectCommand getNonIndexedIndirectCommand(
+      uint32_t instanceCount, uint32_t firstInstance) const;
 
  private:
   void createVertexBuffers(const std::vector<Vertex> &vertices);
@@ -61,5 +100,10 @@ class LveModel {
   bool hasIndexBuffer = false;
   std::unique_ptr<LveBuffer> indexBuffer;
   uint32_t indexCount;
+
+  LveGeometryPool *geometryPool = nullptr;
+  LveGeometryPool::Allocation geometryAllocation{};
+
+  Bounds bounds;
 };
 }  // namespace lve
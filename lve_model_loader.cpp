@@ -0,0 +1,64 @@
+#include "lve_model_loader.hpp"
+
+// std
+#include <exception>
+
+namespace lve {
+
+LveModelLoader::LveModelLoader(LveDevice &device, LveJobSystem &jobSystem)
+    : lveDevice{device}, jobSystem{jobSystem} {}
+
+LveModelLoader::~LveModelLoader() {
+  // resolve outstanding handles rather than leaving them with broken promises
+  if (hasPendingModels()) {
+    finishLoading();
+  }
+}
+
+LveModelLoader::Handle LveModelLoader::loadModel(const std::string &filepath) {
+  PendingModel pending{};
+  pending.builder = jobSystem.submit(
+      [filepath]() {
+        LveModel::Builder builder{};
+        builder.loadModel(filepath);
+        return builder;
+      },
+      &parsing);
+  Handle handle = pending.model.get_future().share();
+  pendingModels.push_back(std::move(pending));
+  return handle;
+}
+
+void LveModelLoader::finishLoading() {
+  // parse errors are carried by the futures, the counter only tracks completion
+  jobSystem.wait(parsing);
+
+  std::vector<LveModel::Builder> builders{};
+  std::vector<PendingModel *> parsedModels{};
+  builders.reserve(pendingModels.size());
+  parsedModels.reserve(pendingModels.size());
+
+  for (auto &pending : pendingModels) {
+    try {
+      builders.push_back(pending.builder.get());
+      parsedModels.push_back(&pending);
+    } catch (...) {
+      pending.model.set_exception(std::current_exception());
+    }
+  }
+
+  try {
+    auto models = LveModel::createModels(lveDevice, builders, geometryPool);
+    for (size_t i = 0; i < models.size(); i++) {
+      parsedModels[i]->model.set_value(std::move(models[i]));
+    }
+  } catch (...) {
+    for (auto pending : parsedModels) {
+      pending->model.set_exception(std::current_exception());
+    }
+  }
+
+  pendingModels.clear();
+}
+
+}  // namespace lve
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_job_system.hpp"
+#include "lve_model.hpp"
+
+// std
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lve {
+
+// Parses model files as jobs and uploads them to the GPU in batches
+class LveModelLoader {
+ public:
+  using Handle = std::shared_future<std::shared_ptr<LveModel>>;
+
+  LveModelLoader(LveDevice &device, LveJobSystem &jobSystem);
+  ~LveModelLoader();
+
+  LveModelLoader(const LveModelLoader &) = delete;
+  LveModelLoader &operator=(const LveModelLoader &) = delete;
+
+  // Starts parsing filepath in the background. The handle becomes ready once finishLoading has
+  // uploaded the model, so don't wait on it before calling finishLoading.
+  Handle loadModel(const std::string &filepath);
+
+  // Waits for all queued files to be parsed, parsing on the calling thread meanwhile, uploads them
+  // with a single submission and resolves their handles. Must be called from the thread that
+  // records to the graphics queue.
+  void finishLoading();
+
+  bool hasPendingModels() const { return !pendingModels.empty(); }
+
+  // Models uploaded by later calls to finishLoading are placed in geometryPool when it has room
+  void setGeometryPool(LveGeometryPool *geometryPool) { this->geometryPool = geometryPool; }
+
+ private:
+  struct PendingModel {
+    std::future<LveModel::Builder> builder;
+    std::promise<std::shared_ptr<LveModel>> model;
+  };
+
+  LveDevice &lveDevice;
+  LveJobSystem &jobSystem;
+  LveJobSystem::Counter parsing;
+  LveGeometryPool *geometryPool = nullptr;
+  std::vector<PendingModel> pendingModels;
+};
+
+}  // namespace lve
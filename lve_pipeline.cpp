@@ -7,24 +7,53 @@
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <utility>
 
 namespace lve {
 
+LveShaderModule::LveShaderModule(LveDevice& device, const std::string& filepath)
+    : lveDevice{device} {
+  auto code = LvePipeline::readFile(filepath);
+
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = code.size();
+  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+  if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module");
+  }
+}
+
+LveShaderModule::~LveShaderModule() {
+  vkDestroyShaderModule(lveDevice.device(), shaderModule, nullptr);
+}
+
 LvePipeline::LvePipeline(
     LveDevice& device,
     const std::string& vertFilepath,
     const std::string& fragFilepath,
     const PipelineConfigInfo& configInfo)
-    : lveDevice{device} {
-  createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
-}
+    : LvePipeline{
+          device,
+          std::make_shared<LveShaderModule>(device, vertFilepath),
+          std::make_shared<LveShaderModule>(device, fragFilepath),
+          configInfo} {}
 
-LvePipeline::~LvePipeline() {
-  vkDestroyShaderModule(lveDevice.device(), vertShaderModule, nullptr);
-  vkDestroyShaderModule(lveDevice.device(), fragShaderModule, nullptr);
-  vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr);
+LvePipeline::LvePipeline(
+    LveDevice& device,
+    std::shared_ptr<LveShaderModule> vertShaderModule,
+    std::shared_ptr<LveShaderModule> fragShaderModule,
+    const PipelineConfigInfo& configInfo)
+    : lveDevice{device},
+      vertShaderModule{std::move(vertShaderModule)},
+      fragShaderModule{std::move(fragShaderModule)} {
+  createGraphicsPipeline(configInfo);
 }
 
+LvePipeline::~LvePipeline() { vkDestroyPipeline(lveDevice.device(), graphicsPipeline, nullptr); }
+
 std::vector<char> LvePipeline::readFile(const std::string& filepath) {
   std::ifstream file{filepath, std::ios::ate | std::ios::binary};
 
@@ -42,10 +71,7 @@ std::vector<char> LvePipeline::readFile(const std::string& filepath) {
   return buffer;
 }
 
-void LvePipeline::createGraphicsPipeline(
-    const std::string& vertFilepath,
-    const std::string& fragFilepath,
-    const PipelineConfigInfo& configInfo) {
+void LvePipeline::createGraphicsPipeline(const PipelineConfigInfo& configInfo) {
   assert(
       configInfo.pipelineLayout != VK_NULL_HANDLE &&
       "Cannot create graphics pipeline: no pipelineLayout provided in configInfo");
@@ -53,30 +79,24 @@ void LvePipeline::createGraphicsPipeline(
       configInfo.renderPass != VK_NULL_HANDLE &&
       "Cannot create graphics pipeline: no renderPass provided in configInfo");
 
-  auto vertCode = readFile(vertFilepath);
-  auto fragCode = readFile(fragFilepath);
-
-  createShaderModule(vertCode, &vertShaderModule);
-  createShaderModule(fragCode, &fragShaderModule);
-
   VkPipelineShaderStageCreateInfo shaderStages[2];
   shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-  shaderStages[0].module = vertShaderModule;
+  shaderStages[0].module = vertShaderModule->getShaderModule();
   shaderStages[0].pName = "main";
   shaderStages[0].flags = 0;
   shaderStages[0].pNext = nullptr;
   shaderStages[0].pSpecializationInfo = nullptr;
   shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-  shaderStages[1].module = fragShaderModule;
+  shaderStages[1].module = fragShaderModule->getShaderModule();
   shaderStages[1].pName = "main";
   shaderStages[1].flags = 0;
   shaderStages[1].pNext = nullptr;
   shaderStages[1].pSpecializationInfo = nullptr;
 
-  auto bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
-  auto attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
+  auto& bindingDescriptions = configInfo.bindingDescriptions;
+  auto& attributeDescriptions = configInfo.attributeDescriptions;
   VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
   vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertexInputInfo.vertexAttributeDescriptionCount =
@@ -107,7 +127,7 @@ void LvePipeline::createGraphicsPipeline(
 
   if (vkCreateGraphicsPipelines(
           lveDevice.device(),
-          VK_NULL_HANDLE,
+          lveDevice.pipelineCache(),
           1,
           &pipelineInfo,
           nullptr,
@@ -116,19 +136,56 @@ void LvePipeline::createGraphicsPipeline(
   }
 }
 
-void LvePipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule) {
-  VkShaderModuleCreateInfo createInfo{};
-  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+void LvePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+}
 
-  if (vkCreateShaderModule(lveDevice.device(), &createInfo, nullptr, shaderModule) != VK_SUCCESS) {
+LveComputePipeline::LveComputePipeline(
+    LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+    : lveDevice{device} {
+  assert(
+      pipelineLayout != VK_NULL_HANDLE &&
+      "Cannot create compute pipeline: no pipelineLayout provided");
+
+  auto compCode = LvePipeline::readFile(compFilepath);
+
+  VkShaderModuleCreateInfo moduleInfo{};
+  moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  moduleInfo.codeSize = compCode.size();
+  moduleInfo.pCode = reinterpret_cast<const uint32_t*>(compCode.data());
+  if (vkCreateShaderModule(lveDevice.device(), &moduleInfo, nullptr, &compShaderModule) !=
+      VK_SUCCESS) {
     throw std::runtime_error("failed to create shader module");
   }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = compShaderModule;
+  pipelineInfo.stage.pName = "main";
+  pipelineInfo.layout = pipelineLayout;
+  pipelineInfo.basePipelineIndex = -1;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (vkCreateComputePipelines(
+          lveDevice.device(),
+          lveDevice.pipelineCache(),
+          1,
+          &pipelineInfo,
+          nullptr,
+          &computePipeline) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline");
+  }
 }
 
-void LvePipeline::bind(VkCommandBuffer commandBuffer) {
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+LveComputePipeline::~LveComputePipeline() {
+  vkDestroyShaderModule(lveDevice.device(), compShaderModule, nullptr);
+  vkDestroyPipeline(lveDevice.device(), computePipeline, nullptr);
+}
+
+void LveComputePipeline::bind(VkCommandBuffer commandBuffer) {
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
 }
 
 void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
@@ -200,6 +257,9 @@ void LvePipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo) {
   configInfo.dynamicStateInfo.dynamicStateCount =
       static_cast<uint32_t>(configInfo.dynamicStateEnables.size());
   configInfo.dynamicStateInfo.flags = 0;
+
+  configInfo.bindingDescriptions = LveModel::Vertex::getBindingDescriptions();
+  configInfo.attributeDescriptions = LveModel::Vertex::getAttributeDescriptions();
 }
 
 }  // namespace lve
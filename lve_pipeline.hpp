@@ -3,15 +3,19 @@
 #include "lve_device.hpp"
 
 // std
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace lve {
 
 struct PipelineConfigInfo {
+  PipelineConfigInfo() = default;
   PipelineConfigInfo(const PipelineConfigInfo&) = delete;
   PipelineConfigInfo& operator=(const PipelineConfigInfo&) = delete;
 
+  std::vector<VkVertexInputBindingDescription> bindingDescriptions{};
+  std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
   VkPipelineViewportStateCreateInfo viewportInfo;
   VkPipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
   VkPipelineRasterizationStateCreateInfo rasterizationInfo;
@@ -26,6 +30,22 @@ struct PipelineConfigInfo {
   uint32_t subpass = 0;
 };
 
+// A compiled SPIR-V file, shared by the pipelines built from it
+class LveShaderModule {
+ public:
+  LveShaderModule(LveDevice& device, const std::string& filepath);
+  ~LveShaderModule();
+
+  LveShaderModule(const LveShaderModule&) = delete;
+  LveShaderModule& operator=(const LveShaderModule&) = delete;
+
+  VkShaderModule getShaderModule() const { return shaderModule; }
+
+ private:
+  LveDevice& lveDevice;
+  VkShaderModule shaderModule;
+};
+
 class LvePipeline {
  public:
   LvePipeline(
@@ -33,6 +53,11 @@ class LvePipeline {
       const std::string& vertFilepath,
       const std::string& fragFilepath,
       const PipelineConfigInfo& configInfo);
+  LvePipeline(
+      LveDevice& device,
+      std::shared_ptr<LveShaderModule> vertShaderModule,
+      std::shared_ptr<LveShaderModule> fragShaderModule,
+      const PipelineConfigInfo& configInfo);
   ~LvePipeline();
 
   LvePipeline(const LvePipeline&) = delete;
@@ -41,20 +66,31 @@ class LvePipeline {
   void bind(VkCommandBuffer commandBuffer);
 
   static void defaultPipelineConfigInfo(PipelineConfigInfo& configInfo);
+  static std::vector<char> readFile(const std::string& filepath);
 
  private:
-  static std::vector<char> readFile(const std::string& filepath);
+  void createGraphicsPipeline(const PipelineConfigInfo& configInfo);
 
-  void createGraphicsPipeline(
-      const std::string& vertFilepath,
-      const std::string& fragFilepath,
-      const PipelineConfigInfo& configInfo);
+  LveDevice& lveDevice;
+  VkPipeline graphicsPipeline;
+  std::shared_ptr<LveShaderModule> vertShaderModule;
+  std::shared_ptr<LveShaderModule> fragShaderModule;
+};
 
-  void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
+class LveComputePipeline {
+ public:
+  LveComputePipeline(
+      LveDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout);
+  ~LveComputePipeline();
+
+  LveComputePipeline(const LveComputePipeline&) = delete;
+  LveComputePipeline& operator=(const LveComputePipeline&) = delete;
+
+  void bind(VkCommandBuffer commandBuffer);
 
+ private:
   LveDevice& lveDevice;
-  VkPipeline graphicsPipeline;
-  VkShaderModule vertShaderModule;
-  VkShaderModule fragShaderModule;
+  VkPipeline computePipeline;
+  VkShaderModule compShaderModule;
 };
 }  // namespace lve
@@ -0,0 +1,59 @@
+#include "lve_pipeline_builder.hpp"
+
+// std
+#include <utility>
+
+namespace lve {
+
+bool LveAsyncPipeline::isReady() const {
+  State current = state.load(std::memory_order_acquire);
+  if (current == State::Failed) {
+    std::rethrow_exception(error);
+  }
+  return current == State::Ready;
+}
+
+LvePipelineBuilder::LvePipelineBuilder(
+    LveDevice& device, LveJobSystem* jobSystem, LvePipelineRegistry* registry)
+    : lveDevice{device}, jobSystem{jobSystem}, registry{registry} {}
+
+LvePipelineBuilder::~LvePipelineBuilder() { wait(); }
+
+std::shared_ptr<LveAsyncPipeline> LvePipelineBuilder::build(
+    const std::string& vertFilepath,
+    const std::string& fragFilepath,
+    std::unique_ptr<PipelineConfigInfo> configInfo,
+    LvePipeline* fallback) {
+  // LveAsyncPipeline is only constructed here, make_shared can't reach its constructor
+  std::shared_ptr<LveAsyncPipeline> result{new LveAsyncPipeline(fallback)};
+  std::shared_ptr<PipelineConfigInfo> config{std::move(configInfo)};
+
+  auto job = [this, result, config, vertFilepath, fragFilepath]() {
+    // failures are handed to whoever polls the pipeline, not to wait
+    try {
+      result->pipeline =
+          registry != nullptr
+              ? registry->getPipeline(vertFilepath, fragFilepath, *config)
+              : std::make_shared<LvePipeline>(lveDevice, vertFilepath, fragFilepath, *config);
+      result->state.store(LveAsyncPipeline::State::Ready, std::memory_order_release);
+    } catch (...) {
+      result->error = std::current_exception();
+      result->state.store(LveAsyncPipeline::State::Failed, std::memory_order_release);
+    }
+  };
+
+  if (jobSystem == nullptr) {
+    job();
+  } else {
+    jobSystem->run(job, &builds, LveJobSystem::Priority::Background);
+  }
+  return result;
+}
+
+void LvePipelineBuilder::wait() {
+  if (jobSystem != nullptr) {
+    jobSystem->wait(builds);
+  }
+}
+
+}  // namespace lve
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_job_system.hpp"
+#include "lve_pipeline.hpp"
+#include "lve_pipeline_registry.hpp"
+
+// std
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string>
+
+namespace lve {
+
+// A graphics pipeline being compiled in the background. Render systems poll it every frame and
+// draw with the fallback pipeline, or another code path, until it is ready.
+class LveAsyncPipeline {
+ public:
+  LveAsyncPipeline(const LveAsyncPipeline &) = delete;
+  LveAsyncPipeline &operator=(const LveAsyncPipeline &) = delete;
+
+  // True once the pipeline has been built, rethrows the exception a failed build threw
+  bool isReady() const;
+  // The built pipeline once ready, the fallback before, which may be null
+  LvePipeline *get() const { return isReady() ? pipeline.get() : fallback; }
+
+ private:
+  friend class LvePipelineBuilder;
+  enum class State { Building, Ready, Failed };
+
+  explicit LveAsyncPipeline(LvePipeline *fallback) : fallback{fallback} {}
+
+  // pipeline and error are written before state is released
+  std::atomic<State> state{State::Building};
+  std::shared_ptr<LvePipeline> pipeline;
+  std::exception_ptr error;
+  LvePipeline *fallback;
+};
+
+// Compiles graphics pipelines as background jobs, which threads waiting on frame work never pick
+// up, so new variants don't hitch the frame that asks for them. Builds go through the device's
+// pipeline cache, which the driver keeps thread safe, so a variant compiled in an earlier run is
+// ready almost immediately.
+class LvePipelineBuilder {
+ public:
+  // Without a job system pipelines are built on the calling thread and are ready on return. With
+  // a registry, identical pipelines are shared instead of built again.
+  LvePipelineBuilder(
+      LveDevice &device, LveJobSystem *jobSystem, LvePipelineRegistry *registry = nullptr);
+  // Waits for the builds in flight
+  ~LvePipelineBuilder();
+
+  LvePipelineBuilder(const LvePipelineBuilder &) = delete;
+  LvePipelineBuilder &operator=(const LvePipelineBuilder &) = delete;
+
+  // configInfo is owned by the build, since its create infos point into it. fallback must
+  // outlive the returned pipeline.
+  std::shared_ptr<LveAsyncPipeline> build(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      std::unique_ptr<PipelineConfigInfo> configInfo,
+      LvePipeline *fallback = nullptr);
+
+  // Waits until every pipeline requested so far has been built or has failed
+  void wait();
+
+  LvePipelineRegistry *getRegistry() const { return registry; }
+
+ private:
+  LveDevice &lveDevice;
+  LveJobSystem *jobSystem;
+  LvePipelineRegistry *registry;
+  LveJobSystem::Counter builds;
+};
+
+}  // namespace lve
@@ -0,0 +1,215 @@
+#include "lve_pipeline_registry.hpp"
+
+// std
+#include <cstring>
+#include <type_traits>
+
+namespace lve {
+
+namespace {
+
+// Appends the bytes of a scalar or handle. Structs are appended field by field, their padding
+// bytes are indeterminate.
+template <typename T>
+void appendValue(std::string &key, const T &value) {
+  static_assert(std::is_scalar<T>::value, "append struct fields one at a time");
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &value, sizeof(T));
+  key.append(bytes, sizeof(T));
+}
+
+void appendString(std::string &key, const std::string &value) {
+  appendValue(key, value.size());
+  key.append(value);
+}
+
+void appendStencilOpState(std::string &key, const VkStencilOpState &state) {
+  appendValue(key, state.failOp);
+  appendValue(key, state.passOp);
+  appendValue(key, state.depthFailOp);
+  appendValue(key, state.compareOp);
+  appendValue(key, state.compareMask);
+  appendValue(key, state.writeMask);
+  appendValue(key, state.reference);
+}
+
+}  // namespace
+
+LvePipelineRegistry::LvePipelineRegistry(LveDevice &device) : lveDevice{device} {}
+
+std::shared_ptr<LveShaderModule> LvePipelineRegistry::getShaderModule(
+    const std::string &filepath) {
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = shaderModules.find(filepath);
+    if (it != shaderModules.end()) {
+      return it->second;
+    }
+  }
+
+  auto shaderModule = std::make_shared<LveShaderModule>(lveDevice, filepath);
+  std::lock_guard<std::mutex> lock{mutex};
+  return shaderModules.emplace(filepath, std::move(shaderModule)).first->second;
+}
+
+std::shared_ptr<LvePipeline> LvePipelineRegistry::getPipeline(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  std::string key = makePipelineKey(vertFilepath, fragFilepath, configInfo);
+  {
+    std::lock_guard<std::mutex> lock{mutex};
+    auto it = pipelines.find(key);
+    if (it != pipelines.end()) {
+      return it->second.pipeline;
+    }
+  }
+
+  auto pipeline = std::make_shared<LvePipeline>(
+      lveDevice,
+      getShaderModule(vertFilepath),
+      getShaderModule(fragFilepath),
+      configInfo);
+  std::lock_guard<std::mutex> lock{mutex};
+  PipelineEntry entry{std::move(pipeline), configInfo.pipelineLayout};
+  return pipelines.emplace(std::move(key), std::move(entry)).first->second.pipeline;
+}
+
+void LvePipelineRegistry::releasePipelines(VkPipelineLayout pipelineLayout) {
+  std::lock_guard<std::mutex> lock{mutex};
+  for (auto it = pipelines.begin(); it != pipelines.end();) {
+    if (it->second.pipelineLayout == pipelineLayout) {
+      it = pipelines.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+size_t LvePipelineRegistry::getPipelineCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return pipelines.size();
+}
+
+size_t LvePipelineRegistry::getShaderModuleCount() {
+  std::lock_guard<std::mutex> lock{mutex};
+  return shaderModules.size();
+}
+
+std::string LvePipelineRegistry::makePipelineKey(
+    const std::string &vertFilepath,
+    const std::string &fragFilepath,
+    const PipelineConfigInfo &configInfo) {
+  // the key holds the state itself rather than a digest of it, so equal keys mean equal state
+  std::string key{};
+  appendString(key, vertFilepath);
+  appendString(key, fragFilepath);
+
+  appendValue(key, configInfo.bindingDescriptions.size());
+  for (auto &binding : configInfo.bindingDescriptions) {
+    appendValue(key, binding.binding);
+    appendValue(key, binding.stride);
+    appendValue(key, binding.inputRate);
+  }
+  appendValue(key, configInfo.attributeDescriptions.size());
+  for (auto &attribute : configInfo.attributeDescriptions) {
+    appendValue(key, attribute.location);
+    appendValue(key, attribute.binding);
+    appendValue(key, attribute.format);
+    appendValue(key, attribute.offset);
+  }
+
+  auto &inputAssembly = configInfo.inputAssemblyInfo;
+  appendValue(key, inputAssembly.topology);
+  appendValue(key, inputAssembly.primitiveRestartEnable);
+
+  // viewports and scissors are usually dynamic, then only their counts matter
+  auto &viewport = configInfo.viewportInfo;
+  appendValue(key, viewport.viewportCount);
+  appendValue(key, viewport.pViewports != nullptr);
+  for (uint32_t i = 0; viewport.pViewports != nullptr && i < viewport.viewportCount; i++) {
+    appendValue(key, viewport.pViewports[i].x);
+    appendValue(key, viewport.pViewports[i].y);
+    appendValue(key, viewport.pViewports[i].width);
+    appendValue(key, viewport.pViewports[i].height);
+    appendValue(key, viewport.pViewports[i].minDepth);
+    appendValue(key, viewport.pViewports[i].maxDepth);
+  }
+  appendValue(key, viewport.scissorCount);
+  appendValue(key, viewport.pScissors != nullptr);
+  for (uint32_t i = 0; viewport.pScissors != nullptr && i < viewport.scissorCount; i++) {
+    appendValue(key, viewport.pScissors[i].offset.x);
+    appendValue(key, viewport.pScissors[i].offset.y);
+    appendValue(key, viewport.pScissors[i].extent.width);
+    appendValue(key, viewport.pScissors[i].extent.height);
+  }
+
+  auto &rasterization = configInfo.rasterizationInfo;
+  appendValue(key, rasterization.depthClampEnable);
+  appendValue(key, rasterization.rasterizerDiscardEnable);
+  appendValue(key, rasterization.polygonMode);
+  appendValue(key, rasterization.cullMode);
+  appendValue(key, rasterization.frontFace);
+  appendValue(key, rasterization.depthBiasEnable);
+  appendValue(key, rasterization.depthBiasConstantFactor);
+  appendValue(key, rasterization.depthBiasClamp);
+  appendValue(key, rasterization.depthBiasSlopeFactor);
+  appendValue(key, rasterization.lineWidth);
+
+  auto &multisample = configInfo.multisampleInfo;
+  appendValue(key, multisample.rasterizationSamples);
+  appendValue(key, multisample.sampleShadingEnable);
+  appendValue(key, multisample.minSampleShading);
+  appendValue(key, multisample.alphaToCoverageEnable);
+  appendValue(key, multisample.alphaToOneEnable);
+  appendValue(key, multisample.pSampleMask != nullptr);
+  if (multisample.pSampleMask != nullptr) {
+    uint32_t maskWords = (static_cast<uint32_t>(multisample.rasterizationSamples) + 31) / 32;
+    for (uint32_t i = 0; i < maskWords; i++) {
+      appendValue(key, multisample.pSampleMask[i]);
+    }
+  }
+
+  auto &colorBlend = configInfo.colorBlendInfo;
+  appendValue(key, colorBlend.logicOpEnable);
+  appendValue(key, colorBlend.logicOp);
+  appendValue(key, colorBlend.attachmentCount);
+  for (uint32_t i = 0; i < colorBlend.attachmentCount; i++) {
+    auto &attachment = colorBlend.pAttachments[i];
+    appendValue(key, attachment.blendEnable);
+    appendValue(key, attachment.srcColorBlendFactor);
+    appendValue(key, attachment.dstColorBlendFactor);
+    appendValue(key, attachment.colorBlendOp);
+    appendValue(key, attachment.srcAlphaBlendFactor);
+    appendValue(key, attachment.dstAlphaBlendFactor);
+    appendValue(key, attachment.alphaBlendOp);
+    appendValue(key, attachment.colorWriteMask);
+  }
+  for (float constant : colorBlend.blendConstants) {
+    appendValue(key, constant);
+  }
+
+  auto &depthStencil = configInfo.depthStencilInfo;
+  appendValue(key, depthStencil.depthTestEnable);
+  appendValue(key, depthStencil.depthWriteEnable);
+  appendValue(key, depthStencil.depthCompareOp);
+  appendValue(key, depthStencil.depthBoundsTestEnable);
+  appendValue(key, depthStencil.stencilTestEnable);
+  appendStencilOpState(key, depthStencil.front);
+  appendStencilOpState(key, depthStencil.back);
+  appendValue(key, depthStencil.minDepthBounds);
+  appendValue(key, depthStencil.maxDepthBounds);
+
+  auto &dynamicState = configInfo.dynamicStateInfo;
+  appendValue(key, dynamicState.dynamicStateCount);
+  for (uint32_t i = 0; i < dynamicState.dynamicStateCount; i++) {
+    appendValue(key, dynamicState.pDynamicStates[i]);
+  }
+
+  appendValue(key, configInfo.pipelineLayout);
+  appendValue(key, configInfo.renderPass);
+  appendValue(key, configInfo.subpass);
+  return key;
+}
+
+}  // namespace lve
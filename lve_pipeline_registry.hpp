@@ -0,0 +1,60 @@
+#pragma once
+
+#include "lve_device.hpp"
+#include "lve_pipeline.hpp"
+
+// std
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace lve {
+
+// Hands out one shared pipeline per distinct shader pair and pipeline state, and one shader module
+// per SPIR-V file, so render systems asking for the same state don't each compile and bind their
+// own copy. Safe to use from several threads. Entries live as long as the registry, unless their
+// pipeline layout is released first. Handles can be reused, so whoever destroys a layout has to
+// release it here beforehand, and the registry must not outlive the render passes it was keyed by.
+class LvePipelineRegistry {
+ public:
+  explicit LvePipelineRegistry(LveDevice &device);
+
+  LvePipelineRegistry(const LvePipelineRegistry &) = delete;
+  LvePipelineRegistry &operator=(const LvePipelineRegistry &) = delete;
+
+  std::shared_ptr<LveShaderModule> getShaderModule(const std::string &filepath);
+
+  // Pipelines are told apart by the shader paths and every field of configInfo that ends up in
+  // the create info, so only identical state is shared
+  std::shared_ptr<LvePipeline> getPipeline(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+
+  // Drops the pipelines created with pipelineLayout, render systems using them keep their copies
+  void releasePipelines(VkPipelineLayout pipelineLayout);
+
+  size_t getPipelineCount();
+  size_t getShaderModuleCount();
+
+ private:
+  static std::string makePipelineKey(
+      const std::string &vertFilepath,
+      const std::string &fragFilepath,
+      const PipelineConfigInfo &configInfo);
+
+  struct PipelineEntry {
+    std::shared_ptr<LvePipeline> pipeline;
+    VkPipelineLayout pipelineLayout;
+  };
+
+  LveDevice &lveDevice;
+
+  // compilation happens outside the lock, a racing thread's duplicate is dropped on insert
+  std::mutex mutex;
+  std::unordered_map<std::string, std::shared_ptr<LveShaderModule>> shaderModules;
+  std::unordered_map<std::string, PipelineEntry> pipelines;
+};
+
+}  // namespace lve
@@ -0,0 +1,68 @@
+#include "lve_range_allocator.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+
+namespace lve {
+
+LveRangeAllocator::LveRangeAllocator(uint64_t size) : size{size}, freeSize{size} {
+  if (size > 0) {
+    freeRanges.push_back({0, size});
+  }
+}
+
+bool LveRangeAllocator::allocate(
+    uint64_t size, uint64_t alignment, Range &range, uint64_t &alignedOffset) {
+  for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+    uint64_t offset = (it->offset + alignment - 1) / alignment * alignment;
+    uint64_t end = offset + size;
+    if (end > it->offset + it->size) {
+      continue;
+    }
+
+    range = {it->offset, end - it->offset};
+    alignedOffset = offset;
+    freeSize -= range.size;
+
+    if (end == it->offset + it->size) {
+      freeRanges.erase(it);
+    } else {
+      it->size = it->offset + it->size - end;
+      it->offset = end;
+    }
+    return true;
+  }
+  return false;
+}
+
+void LveRangeAllocator::free(const Range &range) {
+  assert(range.offset + range.size <= size && "Freed range is out of bounds");
+  freeSize += range.size;
+
+  auto next = std::lower_bound(
+      freeRanges.begin(),
+      freeRanges.end(),
+      range.offset,
+      [](const Range &freeRange, uint64_t offset) { return freeRange.offset < offset; });
+  auto it = freeRanges.insert(next, range);
+  if (std::next(it) != freeRanges.end() && it->offset + it->size == std::next(it)->offset) {
+    it->size += std::next(it)->size;
+    freeRanges.erase(std::next(it));
+  }
+  if (it != freeRanges.begin() && std::prev(it)->offset + std::prev(it)->size == it->offset) {
+    std::prev(it)->size += it->size;
+    freeRanges.erase(it);
+  }
+}
+
+uint64_t LveRangeAllocator::getLargestFreeRange() const {
+  uint64_t largest = 0;
+  for (auto &range : freeRanges) {
+    largest = std::max(largest, range.size);
+  }
+  return largest;
+}
+
+}  // namespace lve
@@ -0,0 +1,37 @@
+#pragma once
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace lve {
+
+// First fit allocator over an abstract [0, size) range, used to carve up memory blocks and pooled
+// buffers. Freed ranges are merged with their neighbours.
+class LveRangeAllocator {
+ public:
+  struct Range {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+  };
+
+  explicit LveRangeAllocator(uint64_t size);
+
+  // Finds size units starting at a multiple of alignment. The returned range includes any
+  // alignment padding and is what must be passed back to free; alignedOffset is where the caller's
+  // data starts.
+  bool allocate(uint64_t size, uint64_t alignment, Range &range, uint64_t &alignedOffset);
+  void free(const Range &range);
+
+  uint64_t getSize() const { return size; }
+  uint64_t getFreeSize() const { return freeSize; }
+  uint64_t getLargestFreeRange() const;
+  uint32_t getFreeRangeCount() const { return static_cast<uint32_t>(freeRanges.size()); }
+
+ private:
+  uint64_t size;
+  uint64_t freeSize;
+  std::vector<Range> freeRanges{};  // sorted by offset, never adjacent
+};
+
+}  // namespace lve
@@ -0,0 +1,101 @@
+#include "lve_render_queue.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+
+namespace lve {
+
+namespace {
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+
+uint64_t keyField(uint32_t value, uint32_t bits, uint32_t shift) {
+  return (static_cast<uint64_t>(value) & ((uint64_t{1} << bits) - 1)) << shift;
+}
+
+}  // namespace
+
+uint32_t LveRenderQueue::getStateId(uint64_t handle) {
+  return stateIds.emplace(handle, static_cast<uint32_t>(stateIds.size())).first->second;
+}
+
+uint64_t LveRenderQueue::makeKey(
+    uint32_t pipelineId,
+    uint32_t descriptorSetId,
+    uint32_t geometryId,
+    uint32_t modelId,
+    float depth,
+    DepthOrder depthOrder) {
+  static_assert(
+      PIPELINE_BITS + DESCRIPTOR_SET_BITS + DEPTH_OCTAVE_BITS + GEOMETRY_BITS + MODEL_BITS +
+              DEPTH_BITS ==
+          64,
+      "key fields must fill the key");
+
+  // non negative floats order like their bit patterns, the top bits keep that order. Written so
+  // NaN also ends up as 0.
+  uint32_t depthBits = 0;
+  if (depth > 0.f) {
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+  }
+
+  // the octave is the float exponent, offset so depths from 2^-16 up to 2^47 each get their own
+  uint32_t depthOctave = 0;
+  if (depthOrder == DepthOrder::FrontToBack && depthBits != 0) {
+    int32_t exponent = static_cast<int32_t>(depthBits >> 23) - 127 + 16;
+    depthOctave = static_cast<uint32_t>(
+        std::min(std::max(exponent, 0), (1 << DEPTH_OCTAVE_BITS) - 1));
+  }
+
+  uint32_t shift = DEPTH_BITS;
+  uint64_t key = depthBits >> (32 - 1 - DEPTH_BITS);
+  key |= keyField(modelId, MODEL_BITS, shift);
+  shift += MODEL_BITS;
+  key |= keyField(geometryId, GEOMETRY_BITS, shift);
+  shift += GEOMETRY_BITS;
+  key |= keyField(depthOctave, DEPTH_OCTAVE_BITS, shift);
+  shift += DEPTH_OCTAVE_BITS;
+  key |= keyField(descriptorSetId, DESCRIPTOR_SET_BITS, shift);
+  shift += DESCRIPTOR_SET_BITS;
+  key |= keyField(pipelineId, PIPELINE_BITS, shift);
+  return key;
+}
+
+void LveRenderQueue::sort() {
+  if (packets.size() < 2) return;
+
+  // one read of the keys counts the digits of every pass
+  std::array<std::array<uint32_t, RADIX_SIZE>, RADIX_PASSES> counts{};
+  for (auto& packet : packets) {
+    for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+      counts[pass][(packet.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+    }
+  }
+
+  scratch.resize(packets.size());
+  for (uint32_t pass = 0; pass < RADIX_PASSES; pass++) {
+    auto& count = counts[pass];
+    uint32_t shift = pass * RADIX_BITS;
+
+    // a digit every key shares, like the pipeline of a single pipeline queue, needs no pass
+    if (count[(packets[0].key >> shift) & (RADIX_SIZE - 1)] == packets.size()) continue;
+
+    uint32_t offset = 0;
+    for (auto& digitCount : count) {
+      uint32_t digitOffset = offset;
+      offset += digitCount;
+      digitCount = digitOffset;
+    }
+    for (auto& packet : packets) {
+      scratch[count[(packet.key >> shift) & (RADIX_SIZE - 1)]++] = packet;
+    }
+    std::swap(packets, scratch);
+  }
+}
+
+}  // namespace lve
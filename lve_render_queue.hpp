@@ -0,0 +1,74 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace lve {
+
+// Collects one draw packet per object and orders them by a 64 bit sort key, so draws sharing a
+// pipeline, descriptor set and geometry are recorded next to each other and their binds only once.
+// Packets sharing all state are ordered front to back, optionally depth goes before geometry.
+class LveRenderQueue {
+ public:
+  // payload is the caller's, typically an index into its own per object data
+  struct Packet {
+    uint64_t key;
+    uint32_t payload;
+  };
+
+  // Key fields from most to least significant. Ids wider than their field wrap around, which only
+  // costs sorting quality, never correctness.
+  static constexpr uint32_t PIPELINE_BITS = 10;
+  static constexpr uint32_t DESCRIPTOR_SET_BITS = 10;
+  static constexpr uint32_t DEPTH_OCTAVE_BITS = 6;
+  static constexpr uint32_t GEOMETRY_BITS = 10;
+  static constexpr uint32_t MODEL_BITS = 10;
+  static constexpr uint32_t DEPTH_BITS = 18;
+
+  enum class DepthOrder {
+    WithinState,  // depth only orders draws that share all their state
+    FrontToBack,  // roughly front to back, grouped by state within each doubling of depth
+  };
+
+  LveRenderQueue() = default;
+
+  LveRenderQueue(const LveRenderQueue &) = delete;
+  LveRenderQueue &operator=(const LveRenderQueue &) = delete;
+
+  // Small ids for the state objects that go into keys, handed out in order of first use and kept
+  // for the lifetime of the queue. Takes pointers or non dispatchable handles.
+  uint32_t getStateId(const void *object) {
+    return getStateId(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(object)));
+  }
+  uint32_t getStateId(uint64_t handle);
+
+  // depth is the view space distance, negative depths sort as 0
+  static uint64_t makeKey(
+      uint32_t pipelineId,
+      uint32_t descriptorSetId,
+      uint32_t geometryId,
+      uint32_t modelId,
+      float depth,
+      DepthOrder depthOrder = DepthOrder::WithinState);
+
+  void clear() { packets.clear(); }
+  void push(uint64_t key, uint32_t payload) { packets.push_back({key, payload}); }
+  void reserve(size_t count) { packets.reserve(count); }
+
+  // Radix sort by key, stable, so packets with equal keys keep the order they were pushed in
+  void sort();
+
+  const std::vector<Packet> &getPackets() const { return packets; }
+  size_t size() const { return packets.size(); }
+  bool empty() const { return packets.empty(); }
+
+ private:
+  std::vector<Packet> packets;
+  std::vector<Packet> scratch;  // the other half of each sort pass, kept to avoid reallocating
+  std::unordered_map<uint64_t, uint32_t> stateIds;
+};
+
+}  // namespace lve
@@ -0,0 +1,34 @@
+#include "lve_render_snapshot.hpp"
+
+namespace lve {
+
+void LveRenderSnapshot::capture(
+    const LveGameObject::Map &gameObjects, const LveCamera &camera, float frameTime) {
+  uint32_t previousSize = size();
+  uint32_t count = gameObjects.size();
+  models.resize(count);
+  modelMatrices.resize(count);
+  normalMatrices.resize(count);
+  matrixVersions.resize(count);
+
+  for (uint32_t slot = 0; slot < count; slot++) {
+    // comparing first avoids reference count traffic for unchanged models
+    auto &model = gameObjects.getObject(slot).model;
+    if (models[slot] != model) {
+      models[slot] = model;
+    }
+
+    uint64_t version = gameObjects.getMatrixVersion(slot);
+    if (version > matrixGeneration || slot >= previousSize) {
+      modelMatrices[slot] = gameObjects.getModelMatrix(slot);
+      normalMatrices[slot] = gameObjects.getNormalMatrix(slot);
+    }
+    matrixVersions[slot] = version;
+  }
+  matrixGeneration = gameObjects.getMatrixGeneration();
+
+  this->camera = camera;
+  this->frameTime = frameTime;
+}
+
+}  // namespace lve
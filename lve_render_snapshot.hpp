@@ -0,0 +1,50 @@
+#pragma once
+
+#include "lve_camera.hpp"
+#include "lve_game_object.hpp"
+#include "lve_model.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// What rendering needs of the game objects and camera at the end of an update, copied out of the
+// game object map so a frame can be recorded while the next one is being simulated. Slots match
+// the map's slots at capture time.
+class LveRenderSnapshot {
+ public:
+  // Copies the models of every slot, but only the matrices that changed since this snapshot was
+  // last captured, so keeping several snapshots costs little for mostly static scenes
+  void capture(const LveGameObject::Map &gameObjects, const LveCamera &camera, float frameTime);
+
+  uint32_t size() const { return static_cast<uint32_t>(models.size()); }
+  LveModel *getModel(uint32_t slot) const { return models[slot].get(); }
+  const glm::mat4 &getModelMatrix(uint32_t slot) const { return modelMatrices[slot]; }
+  const glm::mat3 &getNormalMatrix(uint32_t slot) const { return normalMatrices[slot]; }
+
+  // Same meaning as the game object map's matrix generation and versions at capture time
+  uint64_t getMatrixGeneration() const { return matrixGeneration; }
+  uint64_t getMatrixVersion(uint32_t slot) const { return matrixVersions[slot]; }
+
+  const LveCamera &getCamera() const { return camera; }
+  float getFrameTime() const { return frameTime; }
+
+ private:
+  // shared ownership keeps models alive while a frame still draws objects erased since the capture
+  std::vector<std::shared_ptr<LveModel>> models;
+  std::vector<glm::mat4> modelMatrices;
+  std::vector<glm::mat3> normalMatrices;
+  std::vector<uint64_t> matrixVersions;
+  uint64_t matrixGeneration{0};
+
+  LveCamera camera{};
+  float frameTime{0.f};
+};
+
+}  // namespace lve
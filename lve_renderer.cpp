@@ -1,5 +1,7 @@
 #include "lve_renderer.hpp"
 
+#include "lve_transfer_manager.hpp"
+
 // std
 #include <array>
 #include <cassert>
@@ -7,27 +9,37 @@
 
 namespace lve {
 
-LveRenderer::LveRenderer(LveWindow& window, LveDevice& device)
-    : lveWindow{window}, lveDevice{device} {
+LveRenderer::LveRenderer(
+    LveWindow& window, LveDevice& device, const LveSwapChain::Config& config)
+    : lveWindow{&window}, lveDevice{device}, swapChainConfig{config} {
+  recreateSwapChain();
+  createCommandPools();
+}
+
+LveRenderer::LveRenderer(LveDevice& device, VkExtent2D extent, const LveSwapChain::Config& config)
+    : lveDevice{device}, headlessExtent{extent}, swapChainConfig{config} {
+  assert(device.isHeadless() && "Offscreen renderer needs a headless device");
+  assert(extent.width > 0 && extent.height > 0 && "Offscreen extent must not be empty");
   recreateSwapChain();
-  createCommandBuffers();
+  createCommandPools();
 }
 
-LveRenderer::~LveRenderer() { freeCommandBuffers(); }
+LveRenderer::~LveRenderer() { destroyCommandPools(); }
 
 void LveRenderer::recreateSwapChain() {
-  auto extent = lveWindow.getExtent();
+  auto extent = isHeadless() ? headlessExtent : lveWindow->getExtent();
   while (extent.width == 0 || extent.height == 0) {
-    extent = lveWindow.getExtent();
-    glfwWaitEvents();
+    extent = lveWindow->getExtent();
+    lveWindow->waitEvents();
   }
   vkDeviceWaitIdle(lveDevice.device());
 
   if (lveSwapChain == nullptr) {
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent);
+    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, swapChainConfig);
   } else {
     std::shared_ptr<LveSwapChain> oldSwapChain = std::move(lveSwapChain);
-    lveSwapChain = std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain);
+    lveSwapChain =
+        std::make_unique<LveSwapChain>(lveDevice, extent, oldSwapChain, swapChainConfig);
 
     if (!oldSwapChain->compareSwapFormats(*lveSwapChain.get())) {
       throw std::runtime_error("Swap chain image(or depth) format has changed!");
@@ -35,33 +47,99 @@ void LveRenderer::recreateSwapChain() {
   }
 }
 
-void LveRenderer::createCommandBuffers() {
-  commandBuffers.resize(LveSwapChain::MAX_FRAMES_IN_FLIGHT);
+void LveRenderer::setSwapChainConfig(const LveSwapChain::Config& config) {
+  assert(!isFrameStarted && "Can't change swap chain config while frame is in progress");
+  bool framesInFlightChanged = config.framesInFlight != swapChainConfig.framesInFlight;
+  swapChainConfig = config;
+  recreateSwapChain();
+  // the new swap chain starts over at its first frame, keep the indices in step
+  currentFrameIndex = 0;
+  if (framesInFlightChanged) {
+    // recreateSwapChain waited for the device, so no frame still uses the pools
+    destroyCommandPools();
+    createCommandPools();
+  }
+}
+
+void LveRenderer::createCommandPools() {
+  frameCommandPools.resize(swapChainConfig.framesInFlight);
+  for (auto& frame : frameCommandPools) {
+    createCommandPool(frame.primary, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    frame.threads.resize(recordingThreadCount);
+    for (auto& pool : frame.threads) {
+      createCommandPool(pool, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+    }
+  }
+}
 
-  VkCommandBufferAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandPool = lveDevice.getCommandPool();
-  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+void LveRenderer::destroyCommandPools() {
+  // destroying a pool frees the command buffers allocated from it
+  for (auto& frame : frameCommandPools) {
+    vkDestroyCommandPool(lveDevice.device(), frame.primary.commandPool, nullptr);
+    for (auto& pool : frame.threads) {
+      vkDestroyCommandPool(lveDevice.device(), pool.commandPool, nullptr);
+    }
+  }
+  frameCommandPools.clear();
+}
 
-  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) !=
+void LveRenderer::createCommandPool(CommandPool& pool, VkCommandBufferLevel level) {
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = lveDevice.findPhysicalQueueFamilies().graphicsFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &pool.commandPool) !=
       VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+    throw std::runtime_error("failed to create frame command pool!");
+  }
+  pool.level = level;
+}
+
+void LveRenderer::resetCommandPool(CommandPool& pool) {
+  if (pool.usedCount > 0) {
+    vkResetCommandPool(lveDevice.device(), pool.commandPool, 0);
+    pool.usedCount = 0;
   }
 }
 
-void LveRenderer::freeCommandBuffers() {
-  vkFreeCommandBuffers(
-      lveDevice.device(),
-      lveDevice.getCommandPool(),
-      static_cast<uint32_t>(commandBuffers.size()),
-      commandBuffers.data());
-  commandBuffers.clear();
+VkCommandBuffer LveRenderer::allocateCommandBuffer(CommandPool& pool) {
+  if (pool.usedCount == pool.commandBuffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = pool.level;
+    allocInfo.commandPool = pool.commandPool;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, &commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+    pool.commandBuffers.push_back(commandBuffer);
+  }
+  return pool.commandBuffers[pool.usedCount++];
+}
+
+void LveRenderer::setRecordingThreadCount(uint32_t threadCount) {
+  assert(!isFrameStarted && "Can't change recording thread count while frame is in progress");
+  assert(threadCount > 0 && "Recording thread count must be at least one");
+  if (threadCount == recordingThreadCount) {
+    return;
+  }
+
+  // command buffers of frames still in flight may come from the pools being destroyed
+  vkDeviceWaitIdle(lveDevice.device());
+  destroyCommandPools();
+  recordingThreadCount = threadCount;
+  createCommandPools();
 }
 
 VkCommandBuffer LveRenderer::beginFrame() {
   assert(!isFrameStarted && "Can't call beginFrame while already in progress");
 
+  // uploads recorded since the last frame must be submitted ahead of this frame's commands
+  lveDevice.transferManager().submit();
+
   auto result = lveSwapChain->acquireNextImage(&currentImageIndex);
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreateSwapChain();
@@ -74,9 +152,17 @@ VkCommandBuffer LveRenderer::beginFrame() {
 
   isFrameStarted = true;
 
-  auto commandBuffer = getCurrentCommandBuffer();
+  // the frame's fence was waited on while acquiring, so none of its command buffers are pending
+  auto& frame = frameCommandPools[currentFrameIndex];
+  resetCommandPool(frame.primary);
+  for (auto& pool : frame.threads) {
+    resetCommandPool(pool);
+  }
+
+  auto commandBuffer = allocateCommandBuffer(frame.primary);
   VkCommandBufferBeginInfo beginInfo{};
   beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
   if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
     throw std::runtime_error("failed to begin recording command buffer!");
@@ -93,18 +179,21 @@ void LveRenderer::endFrame() {
 
   auto result = lveSwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-      lveWindow.wasWindowResized()) {
-    lveWindow.resetWindowResizedFlag();
+      (!isHeadless() && lveWindow->wasWindowResized())) {
+    if (!isHeadless()) {
+      lveWindow->resetWindowResizedFlag();
+    }
     recreateSwapChain();
   } else if (result != VK_SUCCESS) {
     throw std::runtime_error("failed to present swap chain image!");
   }
 
   isFrameStarted = false;
-  currentFrameIndex = (currentFrameIndex + 1) % LveSwapChain::MAX_FRAMES_IN_FLIGHT;
+  currentFrameIndex = (currentFrameIndex + 1) % lveSwapChain->getFramesInFlight();
 }
 
-void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
+void LveRenderer::beginSwapChainRenderPass(
+    VkCommandBuffer commandBuffer, VkSubpassContents contents) {
   assert(isFrameStarted && "Can't call beginSwapChainRenderPass if frame is not in progress");
   assert(
       commandBuffer == getCurrentCommandBuffer() &&
@@ -124,8 +213,15 @@ void LveRenderer::beginSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+
+  // only vkCmdExecuteCommands may be recorded into the primary command buffer otherwise
+  if (contents == VK_SUBPASS_CONTENTS_INLINE) {
+    setViewportAndScissor(commandBuffer);
+  }
+}
 
+void LveRenderer::setViewportAndScissor(VkCommandBuffer commandBuffer) {
   VkViewport viewport{};
   viewport.x = 0.0f;
   viewport.y = 0.0f;
@@ -146,4 +242,51 @@ void LveRenderer::endSwapChainRenderPass(VkCommandBuffer commandBuffer) {
   vkCmdEndRenderPass(commandBuffer);
 }
 
+VkCommandBuffer LveRenderer::beginSecondaryCommandBuffer(uint32_t threadIndex) {
+  assert(isFrameStarted && "Can't call beginSecondaryCommandBuffer if frame is not in progress");
+  assert(threadIndex < recordingThreadCount && "Thread index out of range");
+
+  auto commandBuffer =
+      allocateCommandBuffer(frameCommandPools[currentFrameIndex].threads[threadIndex]);
+
+  VkCommandBufferInheritanceInfo inheritanceInfo{};
+  inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritanceInfo.renderPass = lveSwapChain->getRenderPass();
+  inheritanceInfo.subpass = 0;
+  inheritanceInfo.framebuffer = lveSwapChain->getFrameBuffer(currentImageIndex);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                    VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording secondary command buffer!");
+  }
+  // dynamic state is not inherited from the primary command buffer
+  setViewportAndScissor(commandBuffer);
+  return commandBuffer;
+}
+
+void LveRenderer::endSecondaryCommandBuffer(VkCommandBuffer commandBuffer) {
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
+}
+
+void LveRenderer::executeSecondaryCommandBuffers(
+    VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer>& secondaryCommandBuffers) {
+  assert(
+      commandBuffer == getCurrentCommandBuffer() &&
+      "Can't execute secondary command buffers on command buffer from a different frame");
+  if (secondaryCommandBuffers.empty()) {
+    return;
+  }
+  vkCmdExecuteCommands(
+      commandBuffer,
+      static_cast<uint32_t>(secondaryCommandBuffers.size()),
+      secondaryCommandBuffers.data());
+}
+
 }  // namespace lve
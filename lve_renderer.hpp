@@ -12,7 +12,9 @@
 namespace lve {
 class LveRenderer {
  public:
-  LveRenderer(LveWindow &window, LveDevice &device);
+  LveRenderer(LveWindow &window, LveDevice &device, const LveSwapChain::Config &config = {});
+  // Renders offscreen at a fixed extent, for a headless device
+  LveRenderer(LveDevice &device, VkExtent2D extent, const LveSwapChain::Config &config = {});
   ~LveRenderer();
 
   LveRenderer(const LveRenderer &) = delete;
@@ -20,12 +22,36 @@ class LveRenderer {
 
   VkRenderPass getSwapChainRenderPass() const { return lveSwapChain->getRenderPass(); }
   float getAspectRatio() const { return lveSwapChain->extentAspectRatio(); }
+  VkExtent2D getSwapChainExtent() const { return lveSwapChain->getSwapChainExtent(); }
   bool isFrameInProgress() const { return isFrameStarted; }
+  bool isHeadless() const { return lveWindow == nullptr; }
+
+  // Recreates the swap chain with config, waiting for the device to go idle. Frame indices start
+  // over at 0 and stay below config.framesInFlight.
+  void setSwapChainConfig(const LveSwapChain::Config &config);
+  const LveSwapChain::Config &getSwapChainConfig() const { return swapChainConfig; }
+  VkPresentModeKHR getPresentMode() const { return lveSwapChain->getPresentMode(); }
 
   VkCommandBuffer getCurrentCommandBuffer() const {
     assert(isFrameStarted && "Cannot get command buffer when frame not in progress");
-    return commandBuffers[currentFrameIndex];
+    return frameCommandPools[currentFrameIndex].primary.commandBuffers[0];
+  }
+
+  // The color image rendered this frame, in getSwapChainImageLayout() once the render pass ended
+  VkImage getCurrentImage() const {
+    assert(isFrameStarted && "Cannot get image when frame not in progress");
+    return lveSwapChain->getImage(currentImageIndex);
+  }
+  VkImageLayout getSwapChainImageLayout() const { return lveSwapChain->getImageLayout(); }
+  VkFormat getSwapChainImageFormat() const { return lveSwapChain->getSwapChainImageFormat(); }
+  bool supportsReadback() const { return lveSwapChain->supportsReadback(); }
+
+  // Only readable after the render pass when the swap chain config asks for readableDepth
+  VkImageView getCurrentDepthImageView() const {
+    assert(isFrameStarted && "Cannot get depth image view when frame not in progress");
+    return lveSwapChain->getDepthImageView(currentImageIndex);
   }
+  bool hasReadableDepth() const { return lveSwapChain->hasReadableDepth(); }
 
   int getFrameIndex() const {
     assert(isFrameStarted && "Cannot get frame index when frame not in progress");
@@ -34,18 +60,55 @@ class LveRenderer {
 
   VkCommandBuffer beginFrame();
   void endFrame();
-  void beginSwapChainRenderPass(VkCommandBuffer commandBuffer);
+  // Pass VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS to record the render pass from secondary
+  // command buffers, which then hold every command of the pass, including viewport and scissor
+  void beginSwapChainRenderPass(
+      VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   void endSwapChainRenderPass(VkCommandBuffer commandBuffer);
 
+  // Secondary command buffers continuing the swap chain render pass. Each recording thread gets
+  // its own command pool per frame in flight, so a thread index must not be used by two threads
+  // recording at the same time.
+  void setRecordingThreadCount(uint32_t threadCount);
+  uint32_t getRecordingThreadCount() const { return recordingThreadCount; }
+  VkCommandBuffer beginSecondaryCommandBuffer(uint32_t threadIndex);
+  void endSecondaryCommandBuffer(VkCommandBuffer commandBuffer);
+  void executeSecondaryCommandBuffers(
+      VkCommandBuffer commandBuffer, const std::vector<VkCommandBuffer> &secondaryCommandBuffers);
+
  private:
-  void createCommandBuffers();
-  void freeCommandBuffers();
+  // Command buffers are allocated on first use and handed out again after the pool is reset
+  struct CommandPool {
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    std::vector<VkCommandBuffer> commandBuffers;
+    size_t usedCount = 0;
+  };
+
+  // Everything recorded for one frame in flight. The pools are reset wholesale once the frame's
+  // fence has been waited on, instead of resetting command buffers one at a time.
+  struct FrameCommandPools {
+    CommandPool primary;
+    std::vector<CommandPool> threads;
+  };
+
+  void createCommandPools();
+  void destroyCommandPools();
+  void createCommandPool(CommandPool &pool, VkCommandBufferLevel level);
+  void resetCommandPool(CommandPool &pool);
+  VkCommandBuffer allocateCommandBuffer(CommandPool &pool);
+  void setViewportAndScissor(VkCommandBuffer commandBuffer);
   void recreateSwapChain();
 
-  LveWindow &lveWindow;
+  LveWindow *lveWindow = nullptr;  // null when headless
   LveDevice &lveDevice;
+  VkExtent2D headlessExtent{};
   std::unique_ptr<LveSwapChain> lveSwapChain;
-  std::vector<VkCommandBuffer> commandBuffers;
+  LveSwapChain::Config swapChainConfig;
+  // ring indexed by frame index, one entry per configured frame in flight. setSwapChainConfig
+  // rebuilds it when framesInFlight changes.
+  std::vector<FrameCommandPools> frameCommandPools;
+  uint32_t recordingThreadCount{1};
 
   uint32_t currentImageIndex;
   int currentFrameIndex{0};
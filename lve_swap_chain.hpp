@@ -12,13 +12,35 @@
 
 namespace lve {
 
+// More frames in flight and images raise throughput at the cost of input latency. MAILBOX and
+// IMMEDIATE don't wait for vertical blank, IMMEDIATE may tear.
+struct LveSwapChainConfig {
+  uint32_t framesInFlight = 2;  // 1 to LveSwapChain::MAX_FRAMES_IN_FLIGHT
+  // FIFO is used when the surface doesn't support the requested mode, it always is available
+  VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+  // 0 requests one more than the surface minimum, the count is clamped to the surface limits
+  uint32_t imageCount = 0;
+  // Depth is written back to memory and left readable after the render pass, for compute passes
+  // such as occlusion culling. Otherwise it is discarded, which saves the bandwidth.
+  bool readableDepth = false;
+};
+
+// On a headless device the swap chain renders into offscreen color images instead of presentable
+// ones. They are left in TRANSFER_SRC_OPTIMAL for readback and handed out round robin, nothing is
+// presented and presentMode is ignored.
 class LveSwapChain {
  public:
-  static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+  // Upper bound for Config::framesInFlight
+  static constexpr int MAX_FRAMES_IN_FLIGHT = 4;
 
-  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent);
+  using Config = LveSwapChainConfig;
+
+  LveSwapChain(LveDevice &deviceRef, VkExtent2D windowExtent, const Config &config = {});
   LveSwapChain(
-      LveDevice &deviceRef, VkExtent2D windowExtent, std::shared_ptr<LveSwapChain> previous);
+      LveDevice &deviceRef,
+      VkExtent2D windowExtent,
+      std::shared_ptr<LveSwapChain> previous,
+      const Config &config = {});
 
   ~LveSwapChain();
 
@@ -28,7 +50,22 @@ class LveSwapChain {
   VkFramebuffer getFrameBuffer(int index) { return swapChainFramebuffers[index]; }
   VkRenderPass getRenderPass() { return renderPass; }
   VkImageView getImageView(int index) { return swapChainImageViews[index]; }
+  VkImage getImage(int index) { return swapChainImages[index]; }
+  // The layout color images are left in by the render pass
+  VkImageLayout getImageLayout() const {
+    return isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+  }
+  // Whether color images can be copied from, which surfaces don't have to support
+  bool supportsReadback() const { return imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT; }
+  bool isHeadless() const { return device.isHeadless(); }
+  // With Config::readableDepth, depth views are readable in DEPTH_STENCIL_READ_ONLY_OPTIMAL once
+  // the render pass has ended
+  VkImageView getDepthImageView(int index) { return depthImageViews[index]; }
+  bool hasReadableDepth() const { return config.readableDepth; }
   size_t imageCount() { return swapChainImages.size(); }
+  uint32_t getFramesInFlight() const { return config.framesInFlight; }
+  // The mode in use, which differs from the configured one when that one is unsupported
+  VkPresentModeKHR getPresentMode() const { return presentMode; }
   VkFormat getSwapChainImageFormat() { return swapChainImageFormat; }
   VkExtent2D getSwapChainExtent() { return swapChainExtent; }
   uint32_t width() { return swapChainExtent.width; }
@@ -50,6 +87,7 @@ class LveSwapChain {
  private:
   void init();
   void createSwapChain();
+  void createOffscreenImages();
   void createImageViews();
   void createDepthResources();
   void createRenderPass();
@@ -66,20 +104,24 @@ class LveSwapChain {
   VkFormat swapChainImageFormat;
   VkFormat swapChainDepthFormat;
   VkExtent2D swapChainExtent;
+  VkPresentModeKHR presentMode;
+  VkImageUsageFlags imageUsage;
 
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkRenderPass renderPass;
 
   std::vector<VkImage> depthImages;
-  std::vector<VkDeviceMemory> depthImageMemorys;
+  std::vector<LveAllocation> depthImageAllocations;
   std::vector<VkImageView> depthImageViews;
   std::vector<VkImage> swapChainImages;
+  std::vector<LveAllocation> offscreenImageAllocations;  // headless only
   std::vector<VkImageView> swapChainImageViews;
 
   LveDevice &device;
   VkExtent2D windowExtent;
+  Config config;
 
-  VkSwapchainKHR swapChain;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   std::shared_ptr<LveSwapChain> oldSwapChain;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -87,6 +129,7 @@ class LveSwapChain {
   std::vector<VkFence> inFlightFences;
   std::vector<VkFence> imagesInFlight;
   size_t currentFrame = 0;
+  uint32_t nextOffscreenImage = 0;
 };
 
 }  // namespace lve
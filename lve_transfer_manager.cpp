@@ -0,0 +1,247 @@
+#include "lve_transfer_manager.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace lve {
+
+LveTransferManager::LveTransferManager(LveDevice &device, VkDeviceSize stagingSize)
+    : lveDevice{device}, stagingSize{stagingSize} {
+  queue = lveDevice.transferQueue();
+  usesGraphicsQueue = queue == lveDevice.graphicsQueue();
+  stagingAlignment = std::max<VkDeviceSize>(
+      16,
+      lveDevice.properties.limits.optimalBufferCopyOffsetAlignment);
+
+  stagingBuffer = std::make_unique<LveBuffer>(
+      lveDevice,
+      stagingSize,
+      1,
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  stagingBuffer->map();
+
+  createCommandPool();
+  createBatches();
+}
+
+LveTransferManager::~LveTransferManager() {
+  flush();
+  for (auto &batch : batches) {
+    vkDestroyFence(lveDevice.device(), batch.fence, nullptr);
+  }
+  vkDestroyCommandPool(lveDevice.device(), commandPool, nullptr);
+}
+
+void LveTransferManager::createCommandPool() {
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = lveDevice.transferQueueFamily();
+  poolInfo.flags =
+      VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+  if (vkCreateCommandPool(lveDevice.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create transfer command pool!");
+  }
+}
+
+void LveTransferManager::createBatches() {
+  std::array<VkCommandBuffer, BATCH_COUNT> commandBuffers{};
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandPool = commandPool;
+  allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+  if (vkAllocateCommandBuffers(lveDevice.device(), &allocInfo, commandBuffers.data()) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate transfer command buffers!");
+  }
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    batches[i].commandBuffer = commandBuffers[i];
+    if (vkCreateFence(lveDevice.device(), &fenceInfo, nullptr, &batches[i].fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create transfer fence!");
+    }
+  }
+}
+
+void LveTransferManager::uploadToBuffer(
+    VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset) {
+  auto src = static_cast<const char *>(data);
+
+  // uploads larger than the ring are split into chunks that each fit
+  while (size > 0) {
+    VkDeviceSize chunkSize = std::min(size, stagingSize);
+    VkDeviceSize stagingOffset = allocateStaging(chunkSize);
+    auto dst = static_cast<char *>(stagingBuffer->getMappedMemory()) + stagingOffset;
+    std::memcpy(dst, src, chunkSize);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = chunkSize;
+    vkCmdCopyBuffer(
+        getCurrentBatch().commandBuffer,
+        stagingBuffer->getBuffer(),
+        dstBuffer,
+        1,
+        &copyRegion);
+
+    src += chunkSize;
+    dstOffset += chunkSize;
+    size -= chunkSize;
+  }
+}
+
+void LveTransferManager::submit() { submitCurrentBatch(!usesGraphicsQueue); }
+
+void LveTransferManager::flush() {
+  submitCurrentBatch(false);
+  while (!inFlightBatches.empty()) {
+    retireOldestBatch();
+  }
+}
+
+LveTransferManager::Batch &LveTransferManager::getCurrentBatch() {
+  if (currentBatch >= 0) {
+    return batches[currentBatch];
+  }
+
+  if (inFlightBatches.size() == BATCH_COUNT) {
+    retireOldestBatch();
+  }
+  for (int i = 0; i < BATCH_COUNT; i++) {
+    if (std::find(inFlightBatches.begin(), inFlightBatches.end(), i) == inFlightBatches.end()) {
+      currentBatch = i;
+      break;
+    }
+  }
+  assert(currentBatch >= 0 && "No transfer batch available");
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(batches[currentBatch].commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording transfer command buffer!");
+  }
+  return batches[currentBatch];
+}
+
+VkDeviceSize LveTransferManager::allocateStaging(VkDeviceSize size) {
+  assert(size <= stagingSize && "Staging allocation larger than the ring");
+
+  while (true) {
+    VkDeviceSize offset = (stagingHead + stagingAlignment - 1) & ~(stagingAlignment - 1);
+    if (offset + size > stagingSize) {
+      offset = 0;
+    }
+
+    if (isStagingRangeFree(offset, offset + size)) {
+      auto &ranges = getCurrentBatch().stagingRanges;
+      if (!ranges.empty() && ranges.back().end == offset) {
+        ranges.back().end = offset + size;
+      } else {
+        ranges.push_back({offset, offset + size});
+      }
+      stagingHead = offset + size;
+      return offset;
+    }
+
+    // the ring is full: if only the batch being recorded holds it, submit that batch first
+    if (inFlightBatches.empty()) {
+      submitCurrentBatch(false);
+    }
+    retireOldestBatch();
+  }
+}
+
+bool LveTransferManager::isStagingRangeFree(VkDeviceSize begin, VkDeviceSize end) const {
+  auto overlaps = [begin, end](const Batch &batch) {
+    for (auto &range : batch.stagingRanges) {
+      if (begin < range.end && range.begin < end) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  if (currentBatch >= 0 && overlaps(batches[currentBatch])) {
+    return false;
+  }
+  for (int batchIndex : inFlightBatches) {
+    if (overlaps(batches[batchIndex])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void LveTransferManager::submitCurrentBatch(bool waitForCompletion) {
+  if (currentBatch < 0) {
+    return;
+  }
+  auto &batch = batches[currentBatch];
+
+  if (usesGraphicsQueue) {
+    // makes the copies visible to everything submitted to the graphics queue after this batch
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(
+        batch.commandBuffer,
+        VK_PIPELINE_STAGE_TRANSFER_BIT,
+        VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+        0,
+        1,
+        &barrier,
+        0,
+        nullptr,
+        0,
+        nullptr);
+  }
+
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record transfer command buffer!");
+  }
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+  vkResetFences(lveDevice.device(), 1, &batch.fence);
+  if (vkQueueSubmit(queue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit transfer command buffer!");
+  }
+
+  inFlightBatches.push_back(currentBatch);
+  currentBatch = -1;
+
+  if (waitForCompletion) {
+    while (!inFlightBatches.empty()) {
+      retireOldestBatch();
+    }
+  }
+}
+
+void LveTransferManager::retireOldestBatch() {
+  assert(!inFlightBatches.empty() && "No transfer batch in flight");
+  auto &batch = batches[inFlightBatches.front()];
+  vkWaitForFences(
+      lveDevice.device(),
+      1,
+      &batch.fence,
+      VK_TRUE,
+      std::numeric_limits<uint64_t>::max());
+  batch.stagingRanges.clear();
+  inFlightBatches.pop_front();
+}
+
+}  // namespace lve
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "lve_buffer.hpp"
+#include "lve_device.hpp"
+
+// std
+#include <array>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace lve {
+
+// Streams host data into device local buffers through a persistently mapped ring staging buffer.
+// Uploads are recorded into batches that are submitted with a fence, so many copies share one
+// submission and the queue is never waited on idle. Not thread safe, use it from the thread that
+// submits to the graphics queue.
+class LveTransferManager {
+ public:
+  static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 32 * 1024 * 1024;
+  static constexpr int BATCH_COUNT = 4;
+
+  LveTransferManager(LveDevice &device, VkDeviceSize stagingSize = DEFAULT_STAGING_SIZE);
+  ~LveTransferManager();
+
+  LveTransferManager(const LveTransferManager &) = delete;
+  LveTransferManager &operator=(const LveTransferManager &) = delete;
+
+  // Copies size bytes of data into dstBuffer at dstOffset. The data is staged immediately, the copy
+  // executes once the current batch is submitted.
+  void uploadToBuffer(
+      VkBuffer dstBuffer, const void *data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+  // Submits the recorded uploads. Work submitted to the graphics queue afterwards is guaranteed to
+  // see the uploaded data.
+  void submit();
+
+  // Submits the recorded uploads and waits for every submitted batch to complete
+  void flush();
+
+  bool hasPendingUploads() const { return currentBatch >= 0; }
+
+ private:
+  struct StagingRange {
+    VkDeviceSize begin;
+    VkDeviceSize end;
+  };
+
+  struct Batch {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+    std::vector<StagingRange> stagingRanges{};
+  };
+
+  void createCommandPool();
+  void createBatches();
+
+  Batch &getCurrentBatch();
+  VkDeviceSize allocateStaging(VkDeviceSize size);
+  bool isStagingRangeFree(VkDeviceSize begin, VkDeviceSize end) const;
+  void submitCurrentBatch(bool waitForCompletion);
+  void retireOldestBatch();
+
+  LveDevice &lveDevice;
+  VkQueue queue;
+  bool usesGraphicsQueue;
+  VkCommandPool commandPool;
+
+  std::unique_ptr<LveBuffer> stagingBuffer;
+  VkDeviceSize stagingSize;
+  VkDeviceSize stagingAlignment;
+  VkDeviceSize stagingHead = 0;
+
+  std::array<Batch, BATCH_COUNT> batches{};
+  std::deque<int> inFlightBatches{};
+  int currentBatch = -1;
+};
+
+}  // namespace lve
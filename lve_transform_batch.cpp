@@ -0,0 +1,280 @@
+#include "lve_transform_batch.hpp"
+
+// libs
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// std
+#include <cmath>
+
+namespace lve {
+
+namespace {
+
+// Rotation part of Translate * Ry * Rx * Rz * Scale, stored column major so that column i only
+// needs scaling by scale[i], or by its inverse for the normal matrix
+template <typename T>
+struct RotationTerms {
+  T m[3][3];
+
+  RotationTerms(T c1, T s1, T c2, T s2, T c3, T s3) {
+    m[0][0] = c1 * c3 + s1 * s2 * s3;
+    m[0][1] = c2 * s3;
+    m[0][2] = c1 * s2 * s3 - c3 * s1;
+    m[1][0] = c3 * s1 * s2 - c1 * s3;
+    m[1][1] = c2 * c3;
+    m[1][2] = c1 * c3 * s2 + s1 * s3;
+    m[2][0] = c2 * s1;
+    m[2][1] = T{} - s2;
+    m[2][2] = c1 * c2;
+  }
+};
+
+void computeTransformMatrix(
+    const glm::vec3 &translation,
+    const glm::vec3 &rotation,
+    const glm::vec3 &scale,
+    glm::mat4 &modelMatrix,
+    glm::mat3 &normalMatrix) {
+  const RotationTerms<float> r{
+      std::cos(rotation.y),
+      std::sin(rotation.y),
+      std::cos(rotation.x),
+      std::sin(rotation.x),
+      std::cos(rotation.z),
+      std::sin(rotation.z)};
+  for (int column = 0; column < 3; column++) {
+    const float s = scale[column];
+    const float invS = 1.0f / s;
+    modelMatrix[column] =
+        glm::vec4{s * r.m[column][0], s * r.m[column][1], s * r.m[column][2], 0.0f};
+    normalMatrix[column] =
+        glm::vec3{invS * r.m[column][0], invS * r.m[column][1], invS * r.m[column][2]};
+  }
+  modelMatrix[3] = glm::vec4{translation.x, translation.y, translation.z, 1.0f};
+}
+
+#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64)
+
+// Thin wrappers so the sine, cosine and matrix code below is written once for both widths. Only
+// float operations are used, plain AVX has no 256 bit integer instructions.
+struct SseFloats {
+  static constexpr int WIDTH = 4;
+  __m128 v;
+
+  static SseFloats load(const float *p) { return {_mm_load_ps(p)}; }
+  static SseFloats set1(float f) { return {_mm_set1_ps(f)}; }
+  static SseFloats allBits() { return {_mm_castsi128_ps(_mm_set1_epi32(-1))}; }
+  void store(float *p) const { _mm_store_ps(p, v); }
+
+  friend SseFloats operator+(SseFloats a, SseFloats b) { return {_mm_add_ps(a.v, b.v)}; }
+  friend SseFloats operator-(SseFloats a, SseFloats b) { return {_mm_sub_ps(a.v, b.v)}; }
+  friend SseFloats operator*(SseFloats a, SseFloats b) { return {_mm_mul_ps(a.v, b.v)}; }
+  friend SseFloats operator/(SseFloats a, SseFloats b) { return {_mm_div_ps(a.v, b.v)}; }
+  friend SseFloats operator&(SseFloats a, SseFloats b) { return {_mm_and_ps(a.v, b.v)}; }
+  friend SseFloats operator|(SseFloats a, SseFloats b) { return {_mm_or_ps(a.v, b.v)}; }
+  friend SseFloats operator^(SseFloats a, SseFloats b) { return {_mm_xor_ps(a.v, b.v)}; }
+  static SseFloats andNot(SseFloats a, SseFloats b) { return {_mm_andnot_ps(a.v, b.v)}; }
+  static SseFloats equal(SseFloats a, SseFloats b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+  static SseFloats truncate(SseFloats a) { return {_mm_cvtepi32_ps(_mm_cvttps_epi32(a.v))}; }
+};
+
+#if defined(__AVX__)
+struct AvxFloats {
+  static constexpr int WIDTH = 8;
+  __m256 v;
+
+  static AvxFloats load(const float *p) { return {_mm256_load_ps(p)}; }
+  static AvxFloats set1(float f) { return {_mm256_set1_ps(f)}; }
+  static AvxFloats allBits() { return {_mm256_castsi256_ps(_mm256_set1_epi32(-1))}; }
+  void store(float *p) const { _mm256_store_ps(p, v); }
+
+  friend AvxFloats operator+(AvxFloats a, AvxFloats b) { return {_mm256_add_ps(a.v, b.v)}; }
+  friend AvxFloats operator-(AvxFloats a, AvxFloats b) { return {_mm256_sub_ps(a.v, b.v)}; }
+  friend AvxFloats operator*(AvxFloats a, AvxFloats b) { return {_mm256_mul_ps(a.v, b.v)}; }
+  friend AvxFloats operator/(AvxFloats a, AvxFloats b) { return {_mm256_div_ps(a.v, b.v)}; }
+  friend AvxFloats operator&(AvxFloats a, AvxFloats b) { return {_mm256_and_ps(a.v, b.v)}; }
+  friend AvxFloats operator|(AvxFloats a, AvxFloats b) { return {_mm256_or_ps(a.v, b.v)}; }
+  friend AvxFloats operator^(AvxFloats a, AvxFloats b) { return {_mm256_xor_ps(a.v, b.v)}; }
+  static AvxFloats andNot(AvxFloats a, AvxFloats b) { return {_mm256_andnot_ps(a.v, b.v)}; }
+  static AvxFloats equal(AvxFloats a, AvxFloats b) {
+    return {_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)};
+  }
+  static AvxFloats truncate(AvxFloats a) {
+    return {_mm256_round_ps(a.v, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)};
+  }
+};
+#endif
+
+template <typename V>
+V select(V mask, V a, V b) {
+  return (mask & a) | V::andNot(mask, b);
+}
+
+// all bits set in lanes holding an odd whole number
+template <typename V>
+V isOdd(V wholeNumbers) {
+  V half = V::truncate(wholeNumbers * V::set1(0.5f));
+  return V::equal(wholeNumbers - half * V::set1(2.0f), V::set1(1.0f));
+}
+
+// Cephes style sine and cosine: reduce to [-pi/4, pi/4] around the nearest multiple of pi/2 in
+// three steps to keep precision, then evaluate the minimax polynomials for that octant
+template <typename V>
+void sinCos(V x, V &sinX, V &cosX) {
+  const V signBit = V::set1(-0.0f);
+  V sign = x & signBit;
+  x = V::andNot(signBit, x);
+
+  // quadrant counted in half steps, rounded up to the even octant
+  V octant = V::truncate(x * V::set1(1.27323954473516f));  // 4 / pi
+  V quadrant = V::truncate((octant + V::set1(1.0f)) * V::set1(0.5f));
+  octant = quadrant * V::set1(2.0f);
+
+  x = x - octant * V::set1(0.78515625f);
+  x = x - octant * V::set1(2.4187564849853515625e-4f);
+  x = x - octant * V::set1(3.77489497744594108e-8f);
+
+  V quadrantBit0 = isOdd(quadrant);
+  V quadrantBit1 = isOdd(V::truncate(quadrant * V::set1(0.5f)));
+
+  V z = x * x;
+  V cosPoly = V::set1(2.443315711809948e-5f);
+  cosPoly = cosPoly * z + V::set1(-1.388731625493765e-3f);
+  cosPoly = cosPoly * z + V::set1(4.166664568298827e-2f);
+  cosPoly = cosPoly * z * z - z * V::set1(0.5f) + V::set1(1.0f);
+
+  V sinPoly = V::set1(-1.9515295891e-4f);
+  sinPoly = sinPoly * z + V::set1(8.3321608736e-3f);
+  sinPoly = sinPoly * z + V::set1(-1.6666654611e-1f);
+  sinPoly = sinPoly * z * x + x;
+
+  // odd quadrants swap the polynomials, the sign of each follows its own quadrant pattern
+  V sinSign = (quadrantBit1 & signBit) ^ sign;
+  V cosSign = (quadrantBit0 ^ quadrantBit1) & signBit;
+  sinX = select(quadrantBit0, cosPoly, sinPoly) ^ sinSign;
+  cosX = select(quadrantBit0, sinPoly, cosPoly) ^ cosSign;
+}
+
+template <typename V>
+void computeTransformMatrixBlock(
+    const glm::vec3 *translations,
+    const glm::vec3 *rotations,
+    const glm::vec3 *scales,
+    glm::mat4 *modelMatrices,
+    glm::mat3 *normalMatrices) {
+  constexpr int W = V::WIDTH;
+
+  // transpose the block into one register per component
+  alignas(32) float lanes[6][W];
+  for (int k = 0; k < W; k++) {
+    for (int axis = 0; axis < 3; axis++) {
+      lanes[axis][k] = rotations[k][axis];
+      lanes[3 + axis][k] = scales[k][axis];
+    }
+  }
+
+  V sinX, cosX, sinY, cosY, sinZ, cosZ;
+  sinCos(V::load(lanes[0]), sinX, cosX);
+  sinCos(V::load(lanes[1]), sinY, cosY);
+  sinCos(V::load(lanes[2]), sinZ, cosZ);
+  const RotationTerms<V> r{cosY, sinY, cosX, sinX, cosZ, sinZ};
+
+  alignas(32) float model[3][3][W];
+  alignas(32) float normal[3][3][W];
+  for (int column = 0; column < 3; column++) {
+    V s = V::load(lanes[3 + column]);
+    V invS = V::set1(1.0f) / s;
+    for (int row = 0; row < 3; row++) {
+      (s * r.m[column][row]).store(model[column][row]);
+      (invS * r.m[column][row]).store(normal[column][row]);
+    }
+  }
+
+  for (int k = 0; k < W; k++) {
+    glm::mat4 &modelMatrix = modelMatrices[k];
+    glm::mat3 &normalMatrix = normalMatrices[k];
+    for (int column = 0; column < 3; column++) {
+      modelMatrix[column] =
+          glm::vec4{model[column][0][k], model[column][1][k], model[column][2][k], 0.0f};
+      normalMatrix[column] =
+          glm::vec3{normal[column][0][k], normal[column][1][k], normal[column][2][k]};
+    }
+    modelMatrix[3] = glm::vec4{translations[k].x, translations[k].y, translations[k].z, 1.0f};
+  }
+}
+
+#endif
+
+}  // namespace
+
+void computeTransformMatrices(
+    const glm::vec3 *translations,
+    const glm::vec3 *rotations,
+    const glm::vec3 *scales,
+    size_t count,
+    glm::mat4 *modelMatrices,
+    glm::mat3 *normalMatrices) {
+  size_t i = 0;
+
+#if defined(__AVX__)
+  for (; i + AvxFloats::WIDTH <= count; i += AvxFloats::WIDTH) {
+    computeTransformMatrixBlock<AvxFloats>(
+        translations + i,
+        rotations + i,
+        scales + i,
+        modelMatrices + i,
+        normalMatrices + i);
+  }
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+  for (; i + SseFloats::WIDTH <= count; i += SseFloats::WIDTH) {
+    computeTransformMatrixBlock<SseFloats>(
+        translations + i,
+        rotations + i,
+        scales + i,
+        modelMatrices + i,
+        normalMatrices + i);
+  }
+#endif
+
+  for (; i < count; i++) {
+    computeTransformMatrix(
+        translations[i],
+        rotations[i],
+        scales[i],
+        modelMatrices[i],
+        normalMatrices[i]);
+  }
+}
+
+void computeTransformMatrices(
+    LveJobSystem *jobSystem,
+    const glm::vec3 *translations,
+    const glm::vec3 *rotations,
+    const glm::vec3 *scales,
+    size_t count,
+    glm::mat4 *modelMatrices,
+    glm::mat3 *normalMatrices) {
+  if (jobSystem == nullptr) {
+    computeTransformMatrices(
+        translations, rotations, scales, count, modelMatrices, normalMatrices);
+    return;
+  }
+
+  // a multiple of every block width, so only the last range has a scalar tail
+  constexpr size_t TRANSFORMS_PER_JOB = 2048;
+  jobSystem->parallelFor(count, TRANSFORMS_PER_JOB, [&](size_t begin, size_t end) {
+    computeTransformMatrices(
+        translations + begin,
+        rotations + begin,
+        scales + begin,
+        end - begin,
+        modelMatrices + begin,
+        normalMatrices + begin);
+  });
+}
+
+}  // namespace lve
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "lve_job_system.hpp"
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstddef>
+
+namespace lve {
+
+// Writes the model and normal matrices of count transforms, laid out like TransformComponent::mat4
+// and TransformComponent::normalMatrix. The sines and cosines of each rotation are computed once
+// and shared by both matrices, 8 or 4 transforms per iteration depending on the instruction set
+// the engine is built for. The vectorized sine and cosine lose accuracy for angles beyond a few
+// thousand radians, keep rotations wrapped.
+void computeTransformMatrices(
+    const glm::vec3 *translations,
+    const glm::vec3 *rotations,
+    const glm::vec3 *scales,
+    size_t count,
+    glm::mat4 *modelMatrices,
+    glm::mat3 *normalMatrices);
+
+// Same as above, with the transforms split into ranges that run as jobs on jobSystem. Runs on the
+// calling thread alone when jobSystem is null.
+void computeTransformMatrices(
+    LveJobSystem *jobSystem,
+    const glm::vec3 *translations,
+    const glm::vec3 *rotations,
+    const glm::vec3 *scales,
+    size_t count,
+    glm::mat4 *modelMatrices,
+    glm::mat3 *normalMatrices);
+
+}  // namespace lve
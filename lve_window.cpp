@@ -1,6 +1,7 @@
 #include "lve_window.hpp"
 
 // std
+#include <chrono>
 #include <stdexcept>
 
 namespace lve {
@@ -32,9 +33,20 @@ void LveWindow::createWindowSurface(VkInstance instance, VkSurfaceKHR *surface)
 
 void LveWindow::framebufferResizeCallback(GLFWwindow *window, int width, int height) {
   auto lveWindow = reinterpret_cast<LveWindow *>(glfwGetWindowUserPointer(window));
+  {
+    std::lock_guard<std::mutex> lock{lveWindow->extentMutex};
+    lveWindow->width = width;
+    lveWindow->height = height;
+  }
   lveWindow->framebufferResized = true;
-  lveWindow->width = width;
-  lveWindow->height = height;
+}
+
+void LveWindow::waitEvents() {
+  if (std::this_thread::get_id() == eventThreadId) {
+    glfwWaitEvents();
+  } else {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
 }
 
 }  // namespace lve
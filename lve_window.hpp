@@ -3,7 +3,12 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+// std
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <thread>
+
 namespace lve {
 
 class LveWindow {
@@ -15,20 +20,31 @@ class LveWindow {
   LveWindow &operator=(const LveWindow &) = delete;
 
   bool shouldClose() { return glfwWindowShouldClose(window); }
-  VkExtent2D getExtent() { return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)}; }
+  // The extent and resize flag can be read from any thread, they are updated while the thread
+  // that created the window processes events
+  VkExtent2D getExtent() {
+    std::lock_guard<std::mutex> lock{extentMutex};
+    return {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  }
   bool wasWindowResized() { return framebufferResized; }
   void resetWindowResizedFlag() { framebufferResized = false; }
   GLFWwindow *getGLFWwindow() const { return window; }
 
+  // Blocks until window events arrive. Only the thread that created the window may process them,
+  // other threads sleep for a moment instead while that thread keeps polling.
+  void waitEvents();
+
   void createWindowSurface(VkInstance instance, VkSurfaceKHR *surface);
 
  private:
   static void framebufferResizeCallback(GLFWwindow *window, int width, int height);
   void initWindow();
 
+  std::mutex extentMutex;
   int width;
   int height;
-  bool framebufferResized = false;
+  std::atomic<bool> framebufferResized{false};
+  std::thread::id eventThreadId{std::this_thread::get_id()};
 
   std::string windowName;
   GLFWwindow *window;
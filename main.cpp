@@ -1,13 +1,49 @@
-
 #include "first_app.hpp"
 
 // std
 #include <cstdlib>
+#include <cctype>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <stdexcept>
+#include <string>
+
+int main(int argc, char **argv) {
+  // --headless <frames> renders offscreen without a window, e.g. for benchmarks on a server
+  // --capture <file> writes the rendered frames to file as a stream of PPM images
+  auto printUsage = [argv]() {
+    std::cerr << "usage: " << argv[0] << " [--headless <frames>] [--capture <file>]\n";
+    return EXIT_FAILURE;
+  };
+
+  uint32_t headlessFrameCount = 0;
+  std::string capturePath{};
+  try {
+    for (int i = 1; i < argc; i++) {
+      if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+        // stoul skips leading blanks and accepts a sign, the whole argument has to be digits
+        std::string frames{argv[++i]};
+        size_t parsedLength = 0;
+        unsigned long frameCount = std::stoul(frames, &parsedLength);
+        if (!std::isdigit(static_cast<unsigned char>(frames[0])) ||
+            parsedLength != frames.size() || frameCount == 0 ||
+            frameCount > std::numeric_limits<uint32_t>::max()) {
+          return printUsage();
+        }
+        headlessFrameCount = static_cast<uint32_t>(frameCount);
+      } else if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+        capturePath = argv[++i];
+      } else {
+        return printUsage();
+      }
+    }
+  } catch (const std::logic_error &) {
+    // stoul throws invalid_argument or out_of_range
+    return printUsage();
+  }
 
-int main() {
-  lve::FirstApp app{};
+  lve::FirstApp app{headlessFrameCount, capturePath};
 
   try {
     app.run();
@@ -17,4 +53,4 @@ int main() {
   }
 
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
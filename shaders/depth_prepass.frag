@@ -0,0 +1,4 @@
+#version 450
+
+// Depth pre-pass, the fixed function depth test and write do all the work
+void main() {}
@@ -9,6 +9,10 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragPosWorld;
 layout(location = 2) out vec3 fragNormalWorld;
 
+// the depth pre-pass pipeline pairs this shader with another fragment stage, both have to produce
+// exactly the same depth
+invariant gl_Position;
+
 layout(set = 0, binding = 0) uniform GlobalUbo {
   mat4 projectionViewMatrix;
   vec4 ambientLightColor; // w is intensity
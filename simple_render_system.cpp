@@ -7,9 +7,15 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <stdexcept>
+#include <tuple>
+#include <utility>
 
 namespace lve {
 
@@ -18,14 +24,69 @@ struct SimplePushConstantData {
   glm::mat4 normalMatrix{1.f};
 };
 
+namespace {
+
+// Returns a per frame buffer holding at least count instances, growing it when needed. Host
+// visible buffers are kept mapped. The in flight fence for the frame index has already been waited
+// on, so the old buffer can be released safely.
+LveBuffer& getFrameBuffer(
+    LveDevice& device,
+    std::unique_ptr<LveBuffer>& buffer,
+    VkDeviceSize instanceSize,
+    uint32_t count,
+    VkBufferUsageFlags usage,
+    VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+  if (buffer == nullptr || buffer->getInstanceCount() < count) {
+    uint32_t capacity = buffer == nullptr ? 0 : buffer->getInstanceCount();
+    capacity = std::max({count, capacity * 2, 64u});
+    buffer = std::make_unique<LveBuffer>(device, instanceSize, capacity, usage, memoryProperties);
+    if (memoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+      buffer->map();
+    }
+  }
+  return *buffer;
+}
+
+// Draw count per indirect call, commands have to be issued one at a time without multi draw
+uint32_t getMaxDrawIndirectCount(LveDevice& device) {
+  return device.enabledFeatures.multiDrawIndirect ? device.properties.limits.maxDrawIndirectCount
+                                                  : 1;
+}
+
+}  // namespace
+
 SimpleRenderSystem::SimpleRenderSystem(
-    LveDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-    : lveDevice{device} {
+    LveDevice& device,
+    VkRenderPass renderPass,
+    VkDescriptorSetLayout globalSetLayout,
+    uint32_t framesInFlight,
+    LvePipelineBuilder* pipelineBuilder)
+    : lveDevice{device},
+      pipelineBuilder{pipelineBuilder},
+      framesInFlight{framesInFlight},
+      instanceBuffers(framesInFlight),
+      indirectBuffers(framesInFlight),
+      gpuObjectBufferVersions(framesInFlight, 0),
+      gpuObjectBuffers(framesInFlight),
+      gpuDrawCommandBuffers(framesInFlight),
+      gpuInstanceBuffers(framesInFlight) {
   createPipelineLayout(globalSetLayout);
-  createPipeline(renderPass);
+  if (pipelineBuilder != nullptr) {
+    createPipeline(renderPass, *pipelineBuilder);
+  } else {
+    LvePipelineBuilder inlineBuilder{lveDevice, nullptr};
+    createPipeline(renderPass, inlineBuilder);
+  }
 }
 
 SimpleRenderSystem::~SimpleRenderSystem() {
+  if (pipelineBuilder != nullptr) {
+    pipelineBuilder->wait();
+    // the layout handle may be reused, the registry must not hand out pipelines keyed by it
+    if (auto registry = pipelineBuilder->getRegistry()) {
+      registry->releasePipelines(pipelineLayout);
+    }
+  }
   vkDestroyPipelineLayout(lveDevice.device(), pipelineLayout, nullptr);
 }
 
@@ -49,25 +110,476 @@ void SimpleRenderSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLay
   }
 }
 
-void SimpleRenderSystem::createPipeline(VkRenderPass renderPass) {
+void SimpleRenderSystem::createPipeline(
+    VkRenderPass renderPass, LvePipelineBuilder& pipelineBuilder) {
   assert(pipelineLayout != nullptr && "Cannot create pipeline before pipeline layout");
 
   PipelineConfigInfo pipelineConfig{};
   LvePipeline::defaultPipelineConfigInfo(pipelineConfig);
   pipelineConfig.renderPass = renderPass;
   pipelineConfig.pipelineLayout = pipelineLayout;
-  lvePipeline = std::make_unique<LvePipeline>(
-      lveDevice,
+  if (auto registry = pipelineBuilder.getRegistry()) {
+    lvePipeline = registry->getPipeline(
+        "shaders/simple_shader.vert.spv",
+        "shaders/simple_shader.frag.spv",
+        pipelineConfig);
+  } else {
+    lvePipeline = std::make_shared<LvePipeline>(
+        lveDevice,
+        "shaders/simple_shader.vert.spv",
+        "shaders/simple_shader.frag.spv",
+        pipelineConfig);
+  }
+
+  // per instance model and normal matrices are read from a second vertex buffer binding, each
+  // mat4 occupying four consecutive attribute locations. The build keeps the config, so it lives
+  // on the heap.
+  auto instancedConfig = std::make_unique<PipelineConfigInfo>();
+  LvePipeline::defaultPipelineConfigInfo(*instancedConfig);
+  instancedConfig->renderPass = renderPass;
+  instancedConfig->pipelineLayout = pipelineLayout;
+
+  VkVertexInputBindingDescription instanceBinding{};
+  instanceBinding.binding = 1;
+  instanceBinding.stride = sizeof(InstanceData);
+  instanceBinding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+  instancedConfig->bindingDescriptions.push_back(instanceBinding);
+
+  uint32_t location = static_cast<uint32_t>(instancedConfig->attributeDescriptions.size());
+  for (uint32_t column = 0; column < 4; column++) {
+    instancedConfig->attributeDescriptions.push_back(
+        {location + column,
+         1,
+         VK_FORMAT_R32G32B32A32_SFLOAT,
+         static_cast<uint32_t>(offsetof(InstanceData, modelMatrix) + sizeof(glm::vec4) * column)});
+  }
+  location += 4;
+  for (uint32_t column = 0; column < 4; column++) {
+    instancedConfig->attributeDescriptions.push_back(
+        {location + column,
+         1,
+         VK_FORMAT_R32G32B32A32_SFLOAT,
+         static_cast<uint32_t>(offsetof(InstanceData, normalMatrix) + sizeof(glm::vec4) * column)});
+  }
+
+  // its vertex input differs from lvePipeline's, so instead of a fallback pipeline
+  // renderGameObjects draws per object until it is ready
+  instancedPipeline = pipelineBuilder.build(
+      "shaders/simple_instanced_shader.vert.spv",
+      "shaders/simple_shader.frag.spv",
+      std::move(instancedConfig));
+
+  // depth pre-pass variants: the first only writes depth, the second shades without writing it,
+  // passing the test only for the surface the first left in front. Both run the same vertex
+  // shader, its invariant position gives the same depth with either fragment stage.
+  auto depthPrepassConfig = std::make_unique<PipelineConfigInfo>();
+  LvePipeline::defaultPipelineConfigInfo(*depthPrepassConfig);
+  depthPrepassConfig->renderPass = renderPass;
+  depthPrepassConfig->pipelineLayout = pipelineLayout;
+  depthPrepassConfig->colorBlendAttachment.colorWriteMask = 0;
+  depthPrepassPipeline = pipelineBuilder.build(
+      "shaders/simple_shader.vert.spv",
+      "shaders/depth_prepass.frag.spv",
+      std::move(depthPrepassConfig));
+
+  auto prepassShadingConfig = std::make_unique<PipelineConfigInfo>();
+  LvePipeline::defaultPipelineConfigInfo(*prepassShadingConfig);
+  prepassShadingConfig->renderPass = renderPass;
+  prepassShadingConfig->pipelineLayout = pipelineLayout;
+  prepassShadingConfig->depthStencilInfo.depthWriteEnable = VK_FALSE;
+  prepassShadingConfig->depthStencilInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  prepassShadingPipeline = pipelineBuilder.build(
       "shaders/simple_shader.vert.spv",
       "shaders/simple_shader.frag.spv",
-      pipelineConfig);
+      std::move(prepassShadingConfig));
+}
+
+void SimpleRenderSystem::bindModel(
+    LveModel& model, VkCommandBuffer commandBuffer, LveGeometryPool*& boundPool) {
+  // models sharing a geometry pool are drawn from the same buffers, bind those only once
+  LveGeometryPool* geometryPool = model.getGeometryPool();
+  if (geometryPool == nullptr || geometryPool != boundPool) {
+    model.bind(commandBuffer);
+  }
+  boundPool = geometryPool;
+}
+
+void SimpleRenderSystem::cullGameObjects(FrameInfo& frameInfo) {
+  auto& snapshot = frameInfo.snapshot;
+  visibleSlots.clear();
+  for (uint32_t slot = 0; slot < snapshot.size(); slot++) {
+    if (snapshot.getModel(slot) != nullptr) {
+      visibleSlots.push_back(slot);
+    }
+  }
+  if (!frustumCullingEnabled) return;
+
+  LveFrustum frustum{frameInfo.camera.getProjection() * frameInfo.camera.getView()};
+  boundingSpheres.resize(visibleSlots.size());
+  sphereVisibility.resize(visibleSlots.size());
+  auto cullRange = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t slot = visibleSlots[i];
+      // the largest axis scale keeps the sphere conservative under non uniform scaling
+      auto& modelMatrix = snapshot.getModelMatrix(slot);
+      auto& bounds = snapshot.getModel(slot)->getBounds();
+      float scaleSquared = std::max(
+          {glm::dot(glm::vec3{modelMatrix[0]}, glm::vec3{modelMatrix[0]}),
+           glm::dot(glm::vec3{modelMatrix[1]}, glm::vec3{modelMatrix[1]}),
+           glm::dot(glm::vec3{modelMatrix[2]}, glm::vec3{modelMatrix[2]})});
+      boundingSpheres.set(
+          i,
+          glm::vec3{modelMatrix * glm::vec4{bounds.center, 1.f}},
+          bounds.radius * std::sqrt(scaleSquared));
+    }
+    frustum.cullSpheres(boundingSpheres, begin, end, sphereVisibility.data());
+  };
+  if (jobSystem != nullptr) {
+    jobSystem->parallelFor(visibleSlots.size(), OBJECTS_PER_CULL_JOB, cullRange);
+  } else {
+    cullRange(0, visibleSlots.size());
+  }
+
+  size_t visibleCount = 0;
+  for (size_t i = 0; i < visibleSlots.size(); i++) {
+    if (sphereVisibility[i]) {
+      visibleSlots[visibleCount++] = visibleSlots[i];
+    }
+  }
+  visibleSlots.resize(visibleCount);
+}
+
+void SimpleRenderSystem::sortGameObjects(FrameInfo& frameInfo) {
+  auto& snapshot = frameInfo.snapshot;
+  auto& view = frameInfo.camera.getView();
+  uint32_t pipelineId = renderQueue.getStateId(lvePipeline.get());
+  uint32_t descriptorSetId = renderQueue.getStateId(frameInfo.globalDescriptorSet);
+  auto depthOrder = frontToBackEnabled ? LveRenderQueue::DepthOrder::FrontToBack
+                                       : LveRenderQueue::DepthOrder::WithinState;
+
+  renderQueue.clear();
+  renderQueue.reserve(visibleSlots.size());
+  for (uint32_t slot : visibleSlots) {
+    LveModel* model = snapshot.getModel(slot);
+    // pooled models share their vertex and index buffers, so the pool is what gets bound
+    LveGeometryPool* geometryPool = model->getGeometryPool();
+    uint32_t geometryId = geometryPool != nullptr ? renderQueue.getStateId(geometryPool)
+                                                  : renderQueue.getStateId(model);
+    float depth = (view * snapshot.getModelMatrix(slot)[3]).z;
+    renderQueue.push(
+        LveRenderQueue::makeKey(
+            pipelineId,
+            descriptorSetId,
+            geometryId,
+            renderQueue.getStateId(model),
+            depth,
+            depthOrder),
+        slot);
+  }
+  renderQueue.sort();
+
+  auto& packets = renderQueue.getPackets();
+  for (size_t i = 0; i < packets.size(); i++) {
+    visibleSlots[i] = packets[i].payload;
+  }
+}
+
+bool SimpleRenderSystem::useGpuCulling() const {
+  // culled draw commands carry firstInstance, without frustum culling Indirect does the same work
+  return renderMode == RenderMode::GpuCulled && frustumCullingEnabled &&
+         lveDevice.enabledFeatures.drawIndirectFirstInstance && isInstancedPipelineReady();
+}
+
+bool SimpleRenderSystem::needsReadableDepth() const {
+  // leaves out the instanced pipeline being ready, so the answer doesn't flip once it is built
+  return renderMode == RenderMode::GpuCulled && frustumCullingEnabled && occlusionCullingEnabled &&
+         lveDevice.enabledFeatures.drawIndirectFirstInstance;
+}
+
+void SimpleRenderSystem::beforeRenderPass(FrameInfo& frameInfo, VkExtent2D depthExtent) {
+  gpuCullRecorded = false;
+  if (!useGpuCulling()) return;
+
+  writeGpuBatches(frameInfo);
+  if (gpuBatches.empty()) return;
+
+  if (gpuCullingSystem == nullptr) {
+    gpuCullingSystem = std::make_unique<GpuCullingSystem>(lveDevice, framesInFlight);
+  }
+  gpuCullingSystem->setOcclusionCullingEnabled(occlusionCullingEnabled);
+
+  uint32_t objectCount = static_cast<uint32_t>(gpuObjects.size());
+  LveBuffer* previousObjectBuffer = gpuObjectBuffers[frameInfo.frameIndex].get();
+  auto& objectBuffer = getFrameBuffer(
+      lveDevice,
+      gpuObjectBuffers[frameInfo.frameIndex],
+      sizeof(GpuCullingSystem::ObjectData),
+      objectCount,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  uint64_t& syncedVersion = gpuObjectBufferVersions[frameInfo.frameIndex];
+  if (&objectBuffer != previousObjectBuffer) {
+    syncedVersion = 0;
+  }
+
+  // rewrite runs of rows that changed since this frame's buffer was last written
+  constexpr VkDeviceSize rowSize = sizeof(GpuCullingSystem::ObjectData);
+  uint32_t runBegin = 0;
+  while (runBegin < objectCount) {
+    if (gpuObjectVersions[runBegin] <= syncedVersion) {
+      runBegin++;
+      continue;
+    }
+    uint32_t runEnd = runBegin + 1;
+    while (runEnd < objectCount && gpuObjectVersions[runEnd] > syncedVersion) {
+      runEnd++;
+    }
+    objectBuffer.writeToBuffer(
+        &gpuObjects[runBegin],
+        rowSize * (runEnd - runBegin),
+        rowSize * runBegin);
+    runBegin = runEnd;
+  }
+  objectBuffer.flush();
+  syncedVersion = gpuObjectVersion;
+
+  auto& drawCommandBuffer = getFrameBuffer(
+      lveDevice,
+      gpuDrawCommandBuffers[frameInfo.frameIndex],
+      sizeof(GpuCullingSystem::DrawCommand),
+      static_cast<uint32_t>(gpuDrawCommands.size()),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  drawCommandBuffer.writeToBuffer(
+      gpuDrawCommands.data(),
+      sizeof(GpuCullingSystem::DrawCommand) * gpuDrawCommands.size());
+  drawCommandBuffer.flush();
+
+  // only ever written by the cull shader, so it can live in device local memory
+  auto& instanceBuffer = getFrameBuffer(
+      lveDevice,
+      gpuInstanceBuffers[frameInfo.frameIndex],
+      sizeof(InstanceData),
+      objectCount,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+  gpuCullingSystem->cull(
+      frameInfo.commandBuffer,
+      frameInfo.frameIndex,
+      frameInfo.camera.getProjection() * frameInfo.camera.getView(),
+      depthExtent,
+      objectCount,
+      objectBuffer,
+      drawCommandBuffer,
+      instanceBuffer);
+  gpuCullRecorded = true;
+}
+
+void SimpleRenderSystem::afterRenderPass(FrameInfo& frameInfo, VkImageView depthImageView) {
+  if (!gpuCullRecorded) return;
+  gpuCullRecorded = false;
+  if (depthImageView == VK_NULL_HANDLE) {
+    gpuCullingSystem->invalidateDepthPyramid();
+    return;
+  }
+  gpuCullingSystem->buildDepthPyramid(
+      frameInfo.commandBuffer,
+      frameInfo.frameIndex,
+      depthImageView);
+}
+
+void SimpleRenderSystem::writeGpuBatches(FrameInfo& frameInfo) {
+  static_assert(
+      sizeof(GpuCullingSystem::DrawCommand) == sizeof(VkDrawIndexedIndirectCommand),
+      "draw commands must use the indexed indirect stride");
+
+  // every object with a model is uploaded, the cull shader decides which ones are drawn
+  auto& snapshot = frameInfo.snapshot;
+  gpuBatches.clear();
+  gpuBatchIndices.clear();
+  for (uint32_t slot = 0; slot < snapshot.size(); slot++) {
+    LveModel* model = snapshot.getModel(slot);
+    if (model == nullptr) continue;
+    auto result = gpuBatchIndices.try_emplace(model, static_cast<uint32_t>(gpuBatches.size()));
+    if (result.second) {
+      gpuBatches.push_back({model, 0, 0});
+    }
+    gpuBatches[result.first->second].objectCount++;
+  }
+
+  // pooled indexed batches end up next to each other so they can share multi draw calls
+  std::sort(gpuBatches.begin(), gpuBatches.end(), [](const GpuBatch& a, const GpuBatch& b) {
+    return std::make_tuple(a.model->getGeometryPool(), !a.model->isIndexed(), a.model) <
+           std::make_tuple(b.model->getGeometryPool(), !b.model->isIndexed(), b.model);
+  });
+
+  // each batch owns an instance range sized for all of its objects, the cull shader counts the
+  // survivors into instanceCount starting from 0
+  gpuDrawCommands.resize(gpuBatches.size());
+  uint32_t firstInstance = 0;
+  for (uint32_t i = 0; i < gpuBatches.size(); i++) {
+    auto& batch = gpuBatches[i];
+    gpuBatchIndices[batch.model] = i;
+    batch.firstInstance = firstInstance;
+    firstInstance += batch.objectCount;
+
+    auto& command = gpuDrawCommands[i];
+    command = {};
+    if (batch.model->isIndexed()) {
+      auto indexedCommand = batch.model->getIndirectCommand(0, batch.firstInstance);
+      std::memcpy(command.data, &indexedCommand, sizeof(indexedCommand));
+    } else {
+      auto nonIndexedCommand = batch.model->getNonIndexedIndirectCommand(0, batch.firstInstance);
+      std::memcpy(command.data, &nonIndexedCommand, sizeof(nonIndexedCommand));
+    }
+  }
+
+  // only rows whose matrices or batch changed get a new version and are uploaded again
+  gpuObjectVersion++;
+  gpuObjects.resize(snapshot.size());
+  gpuObjectVersions.resize(snapshot.size(), gpuObjectVersion);
+  for (uint32_t slot = 0; slot < snapshot.size(); slot++) {
+    LveModel* model = snapshot.getModel(slot);
+    auto& row = gpuObjects[slot];
+    bool changed = false;
+
+    if (snapshot.getMatrixVersion(slot) > gpuMatrixGeneration) {
+      row.modelMatrix = snapshot.getModelMatrix(slot);
+      row.normalMatrix = snapshot.getNormalMatrix(slot);
+      changed = true;
+    }
+
+    uint32_t batchIndex = GpuCullingSystem::NO_BATCH;
+    uint32_t firstInstance = 0;
+    glm::vec4 boundingSphere{0.f};
+    if (model != nullptr) {
+      auto& bounds = model->getBounds();
+      batchIndex = gpuBatchIndices[model];
+      firstInstance = gpuBatches[batchIndex].firstInstance;
+      boundingSphere = glm::vec4{bounds.center, bounds.radius};
+    }
+    if (row.batchIndex != batchIndex || row.firstInstance != firstInstance ||
+        row.boundingSphere != boundingSphere) {
+      row.batchIndex = batchIndex;
+      row.firstInstance = firstInstance;
+      row.boundingSphere = boundingSphere;
+      changed = true;
+    }
+
+    if (changed) {
+      gpuObjectVersions[slot] = gpuObjectVersion;
+    }
+  }
+  gpuMatrixGeneration = snapshot.getMatrixGeneration();
 }
 
 void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
-  lvePipeline->bind(frameInfo.commandBuffer);
+  // the cull dispatch recorded by beforeRenderPass has already picked this frame's instances
+  if (gpuCullRecorded) {
+    renderGameObjectsGpuCulled(frameInfo);
+    return;
+  }
+
+  cullGameObjects(frameInfo);
+  sortGameObjects(frameInfo);
+
+  // the render pass was begun for inline commands, so the fallback can't record in parallel
+  if (renderMode != RenderMode::PerObject && !isInstancedPipelineReady()) {
+    recordGameObjectsInline(frameInfo);
+    return;
+  }
+
+  switch (renderMode) {
+    case RenderMode::PerObject:
+      renderGameObjectsPerObject(frameInfo);
+      break;
+    case RenderMode::Instanced:
+      renderGameObjectsInstanced(frameInfo);
+      break;
+    case RenderMode::Indirect:
+    case RenderMode::GpuCulled:
+      // indirect commands carry firstInstance, which is only honoured with this feature
+      if (lveDevice.enabledFeatures.drawIndirectFirstInstance) {
+        renderGameObjectsIndirect(frameInfo);
+      } else {
+        renderGameObjectsInstanced(frameInfo);
+      }
+      break;
+  }
+}
+
+void SimpleRenderSystem::renderGameObjectsPerObject(FrameInfo& frameInfo) {
+  if (useParallelRecording()) {
+    renderGameObjectsParallel(frameInfo);
+    return;
+  }
+  recordGameObjectsInline(frameInfo);
+}
+
+void SimpleRenderSystem::renderGameObjectsParallel(FrameInfo& frameInfo) {
+  // a render pass begun for secondary command buffers may also execute none
+  size_t objectCount = visibleSlots.size();
+  if (objectCount == 0) return;
+
+  size_t rangeCount = std::min<size_t>(
+      recordingRenderer->getRecordingThreadCount(),
+      (objectCount + MIN_OBJECTS_PER_RECORDING_THREAD - 1) / MIN_OBJECTS_PER_RECORDING_THREAD);
+  size_t rangeSize = (objectCount + rangeCount - 1) / rangeCount;
+
+  // with the depth pre-pass every range records two buffers, all the pre-pass buffers are
+  // executed before the first shading one
+  bool depthPrepass = useDepthPrepass();
+  LvePipeline& shadingPipeline = depthPrepass ? *prepassShadingPipeline->get() : *lvePipeline;
+  secondaryCommandBuffers.assign(depthPrepass ? 2 * rangeCount : rangeCount, VK_NULL_HANDLE);
+  jobSystem->parallelFor(objectCount, rangeSize, [&](size_t begin, size_t end) {
+    // every range has its own thread index, so no two ranges share a command pool
+    size_t range = begin / rangeSize;
+    uint32_t threadIndex = static_cast<uint32_t>(range);
+    if (depthPrepass) {
+      auto prepassCommandBuffer = recordingRenderer->beginSecondaryCommandBuffer(threadIndex);
+      recordGameObjects(
+          frameInfo,
+          prepassCommandBuffer,
+          *depthPrepassPipeline->get(),
+          visibleSlots.data() + begin,
+          end - begin);
+      recordingRenderer->endSecondaryCommandBuffer(prepassCommandBuffer);
+      secondaryCommandBuffers[range] = prepassCommandBuffer;
+    }
+
+    auto commandBuffer = recordingRenderer->beginSecondaryCommandBuffer(threadIndex);
+    recordGameObjects(
+        frameInfo, commandBuffer, shadingPipeline, visibleSlots.data() + begin, end - begin);
+    recordingRenderer->endSecondaryCommandBuffer(commandBuffer);
+    secondaryCommandBuffers[depthPrepass ? rangeCount + range : range] = commandBuffer;
+  });
+
+  recordingRenderer->executeSecondaryCommandBuffers(
+      frameInfo.commandBuffer, secondaryCommandBuffers);
+}
+
+void SimpleRenderSystem::recordGameObjectsInline(FrameInfo& frameInfo) {
+  const uint32_t* slots = visibleSlots.data();
+  size_t count = visibleSlots.size();
+  if (useDepthPrepass()) {
+    recordGameObjects(
+        frameInfo, frameInfo.commandBuffer, *depthPrepassPipeline->get(), slots, count);
+    recordGameObjects(
+        frameInfo, frameInfo.commandBuffer, *prepassShadingPipeline->get(), slots, count);
+  } else {
+    recordGameObjects(frameInfo, frameInfo.commandBuffer, *lvePipeline, slots, count);
+  }
+}
+
+void SimpleRenderSystem::recordGameObjects(
+    FrameInfo& frameInfo,
+    VkCommandBuffer commandBuffer,
+    LvePipeline& pipeline,
+    const uint32_t* slots,
+    size_t count) {
+  pipeline.bind(commandBuffer);
 
   vkCmdBindDescriptorSets(
-      frameInfo.commandBuffer,
+      commandBuffer,
       VK_PIPELINE_BIND_POINT_GRAPHICS,
       pipelineLayout,
       0,
@@ -76,22 +588,214 @@ void SimpleRenderSystem::renderGameObjects(FrameInfo& frameInfo) {
       0,
       nullptr);
 
-  for (auto& kv : frameInfo.gameObjects) {
-    auto& obj = kv.second;
-    if (obj.model == nullptr) continue;
+  // slots come sorted by sortGameObjects, so runs of the same model skip the bind entirely
+  auto& snapshot = frameInfo.snapshot;
+  LveGeometryPool* boundPool = nullptr;
+  LveModel* boundModel = nullptr;
+  for (size_t i = 0; i < count; i++) {
+    uint32_t slot = slots[i];
+    LveModel* model = snapshot.getModel(slot);
     SimplePushConstantData push{};
-    push.modelMatrix = obj.transform.mat4();
-    push.normalMatrix = obj.transform.normalMatrix();
+    push.modelMatrix = snapshot.getModelMatrix(slot);
+    push.normalMatrix = snapshot.getNormalMatrix(slot);
 
     vkCmdPushConstants(
-        frameInfo.commandBuffer,
+        commandBuffer,
         pipelineLayout,
         VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
         0,
         sizeof(SimplePushConstantData),
         &push);
-    obj.model->bind(frameInfo.commandBuffer);
-    obj.model->draw(frameInfo.commandBuffer);
+    if (model != boundModel) {
+      bindModel(*model, commandBuffer, boundPool);
+      boundModel = model;
+    }
+    model->draw(commandBuffer);
+  }
+}
+
+LveBuffer* SimpleRenderSystem::writeInstanceBatches(FrameInfo& frameInfo) {
+  // group visible objects by model, reusing the batch vectors from previous frames
+  for (auto& kv : instanceBatches) {
+    kv.second.clear();
+  }
+  auto& snapshot = frameInfo.snapshot;
+  for (uint32_t slot : visibleSlots) {
+    instanceBatches[snapshot.getModel(slot)].push_back(
+        {snapshot.getModelMatrix(slot), snapshot.getNormalMatrix(slot)});
+  }
+
+  uint32_t instanceCount = 0;
+  for (auto it = instanceBatches.begin(); it != instanceBatches.end();) {
+    if (it->second.empty()) {
+      it = instanceBatches.erase(it);
+    } else {
+      instanceCount += static_cast<uint32_t>(it->second.size());
+      ++it;
+    }
+  }
+  if (instanceCount == 0) return nullptr;
+
+  auto& instanceBuffer = getFrameBuffer(
+      lveDevice,
+      instanceBuffers[frameInfo.frameIndex],
+      sizeof(InstanceData),
+      instanceCount,
+      VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+  VkDeviceSize offset = 0;
+  for (auto& kv : instanceBatches) {
+    VkDeviceSize size = sizeof(InstanceData) * kv.second.size();
+    instanceBuffer.writeToBuffer(kv.second.data(), size, offset);
+    offset += size;
+  }
+  instanceBuffer.flush();
+  return &instanceBuffer;
+}
+
+void SimpleRenderSystem::bindInstancedPipeline(FrameInfo& frameInfo, LveBuffer& instanceBuffer) {
+  instancedPipeline->get()->bind(frameInfo.commandBuffer);
+
+  vkCmdBindDescriptorSets(
+      frameInfo.commandBuffer,
+      VK_PIPELINE_BIND_POINT_GRAPHICS,
+      pipelineLayout,
+      0,
+      1,
+      &frameInfo.globalDescriptorSet,
+      0,
+      nullptr);
+
+  VkBuffer buffers[] = {instanceBuffer.getBuffer()};
+  VkDeviceSize offsets[] = {0};
+  vkCmdBindVertexBuffers(frameInfo.commandBuffer, 1, 1, buffers, offsets);
+}
+
+void SimpleRenderSystem::renderGameObjectsInstanced(FrameInfo& frameInfo) {
+  LveBuffer* instanceBuffer = writeInstanceBatches(frameInfo);
+  if (instanceBuffer == nullptr) return;
+  bindInstancedPipeline(frameInfo, *instanceBuffer);
+
+  uint32_t firstInstance = 0;
+  LveGeometryPool* boundPool = nullptr;
+  for (auto& kv : instanceBatches) {
+    uint32_t batchSize = static_cast<uint32_t>(kv.second.size());
+    bindModel(*kv.first, frameInfo.commandBuffer, boundPool);
+    kv.first->draw(frameInfo.commandBuffer, batchSize, firstInstance);
+    firstInstance += batchSize;
+  }
+}
+
+void SimpleRenderSystem::renderGameObjectsIndirect(FrameInfo& frameInfo) {
+  LveBuffer* instanceBuffer = writeInstanceBatches(frameInfo);
+  if (instanceBuffer == nullptr) return;
+  bindInstancedPipeline(frameInfo, *instanceBuffer);
+
+  // pooled indexed models become indirect commands, the rest are drawn directly
+  indirectDraws.clear();
+  uint32_t firstInstance = 0;
+  LveGeometryPool* boundPool = nullptr;
+  for (auto& kv : instanceBatches) {
+    uint32_t batchSize = static_cast<uint32_t>(kv.second.size());
+    LveModel& model = *kv.first;
+    if (model.getGeometryPool() != nullptr && model.isIndexed()) {
+      indirectDraws.emplace_back(
+          model.getGeometryPool(),
+          model.getIndirectCommand(batchSize, firstInstance));
+    } else {
+      bindModel(model, frameInfo.commandBuffer, boundPool);
+      model.draw(frameInfo.commandBuffer, batchSize, firstInstance);
+    }
+    firstInstance += batchSize;
+  }
+  if (indirectDraws.empty()) return;
+
+  std::stable_sort(indirectDraws.begin(), indirectDraws.end(), [](auto& a, auto& b) {
+    return a.first < b.first;
+  });
+
+  auto& indirectBuffer = getFrameBuffer(
+      lveDevice,
+      indirectBuffers[frameInfo.frameIndex],
+      sizeof(VkDrawIndexedIndirectCommand),
+      static_cast<uint32_t>(indirectDraws.size()),
+      VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+  for (size_t i = 0; i < indirectDraws.size(); i++) {
+    indirectBuffer.writeToIndex(&indirectDraws[i].second, static_cast<int>(i));
+  }
+  indirectBuffer.flush();
+
+  uint32_t maxDrawCount = getMaxDrawIndirectCount(lveDevice);
+  constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  // one call per run of commands sharing a pool, split only by the device's draw count limit
+  size_t runBegin = 0;
+  while (runBegin < indirectDraws.size()) {
+    LveGeometryPool* geometryPool = indirectDraws[runBegin].first;
+    size_t runEnd = runBegin;
+    while (runEnd < indirectDraws.size() && indirectDraws[runEnd].first == geometryPool) {
+      runEnd++;
+    }
+
+    geometryPool->bind(frameInfo.commandBuffer);
+    for (size_t first = runBegin; first < runEnd; first += maxDrawCount) {
+      uint32_t drawCount = static_cast<uint32_t>(std::min<size_t>(maxDrawCount, runEnd - first));
+      vkCmdDrawIndexedIndirect(
+          frameInfo.commandBuffer,
+          indirectBuffer.getBuffer(),
+          first * stride,
+          drawCount,
+          stride);
+    }
+    runBegin = runEnd;
+  }
+}
+
+void SimpleRenderSystem::renderGameObjectsGpuCulled(FrameInfo& frameInfo) {
+  bindInstancedPipeline(frameInfo, *gpuInstanceBuffers[frameInfo.frameIndex]);
+
+  VkBuffer drawCommandBuffer = gpuDrawCommandBuffers[frameInfo.frameIndex]->getBuffer();
+  uint32_t maxDrawCount = getMaxDrawIndirectCount(lveDevice);
+  constexpr uint32_t stride = sizeof(GpuCullingSystem::DrawCommand);
+
+  // batches whose objects were all culled still issue their command, with an instanceCount of 0
+  LveGeometryPool* boundPool = nullptr;
+  size_t runBegin = 0;
+  while (runBegin < gpuBatches.size()) {
+    LveModel& model = *gpuBatches[runBegin].model;
+    LveGeometryPool* geometryPool = model.getGeometryPool();
+    bindModel(model, frameInfo.commandBuffer, boundPool);
+
+    if (geometryPool == nullptr || !model.isIndexed()) {
+      if (model.isIndexed()) {
+        vkCmdDrawIndexedIndirect(
+            frameInfo.commandBuffer,
+            drawCommandBuffer,
+            runBegin * stride,
+            1,
+            stride);
+      } else {
+        vkCmdDrawIndirect(frameInfo.commandBuffer, drawCommandBuffer, runBegin * stride, 1, stride);
+      }
+      runBegin++;
+      continue;
+    }
+
+    size_t runEnd = runBegin;
+    while (runEnd < gpuBatches.size() &&
+           gpuBatches[runEnd].model->getGeometryPool() == geometryPool &&
+           gpuBatches[runEnd].model->isIndexed()) {
+      runEnd++;
+    }
+    for (size_t first = runBegin; first < runEnd; first += maxDrawCount) {
+      uint32_t drawCount = static_cast<uint32_t>(std::min<size_t>(maxDrawCount, runEnd - first));
+      vkCmdDrawIndexedIndirect(
+          frameInfo.commandBuffer,
+          drawCommandBuffer,
+          first * stride,
+          drawCount,
+          stride);
+    }
+    runBegin = runEnd;
   }
 }
 
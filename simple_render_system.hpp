@@ -1,34 +1,191 @@
 #pragma once
 
+#include "gpu_culling_system.hpp"
+#include "lve_buffer.hpp"
 #include "lve_camera.hpp"
 #include "lve_device.hpp"
 #include "lve_frame_info.hpp"
+#include "lve_frustum.hpp"
 #include "lve_game_object.hpp"
+#include "lve_job_system.hpp"
 #include "lve_pipeline.hpp"
+#include "lve_pipeline_builder.hpp"
+#include "lve_render_queue.hpp"
+#include "lve_renderer.hpp"
 
 // std
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace lve {
 class SimpleRenderSystem {
  public:
+  // Per frame buffers are kept for framesInFlight frames, the renderer's. With a pipeline builder
+  // the instanced pipeline, which every mode but PerObject needs, is compiled in the background.
+  // Objects are drawn one at a time until it is ready.
   SimpleRenderSystem(
-      LveDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+      LveDevice &device,
+      VkRenderPass renderPass,
+      VkDescriptorSetLayout globalSetLayout,
+      uint32_t framesInFlight,
+      LvePipelineBuilder *pipelineBuilder = nullptr);
   ~SimpleRenderSystem();
 
   SimpleRenderSystem(const SimpleRenderSystem &) = delete;
   SimpleRenderSystem &operator=(const SimpleRenderSystem &) = delete;
 
+  enum class RenderMode {
+    PerObject,  // one push constant update and draw call per game object
+    Instanced,  // one instanced draw call per model
+    Indirect,   // one multi draw indirect call per geometry pool, plus unpooled models
+    GpuCulled,  // like Indirect, with culling and instance compaction done in a compute shader
+  };
+
+  // GpuCulled mode records its cull dispatch here, before the render pass begins, and builds the
+  // depth pyramid for the next frame's occlusion test after the render pass has ended. Both are
+  // no-ops in the other modes. depthImageView is VK_NULL_HANDLE when depth was not kept, the next
+  // frame is then culled without occlusion.
+  void beforeRenderPass(FrameInfo &frameInfo, VkExtent2D depthExtent);
   void renderGameObjects(FrameInfo &frameInfo);
+  void afterRenderPass(FrameInfo &frameInfo, VkImageView depthImageView);
+
+  // Whether afterRenderPass reads the depth attachment, which the swap chain only keeps on request
+  bool needsReadableDepth() const;
+
+  void setRenderMode(RenderMode mode) { renderMode = mode; }
+  RenderMode getRenderMode() const { return renderMode; }
+
+  // Objects whose bounding sphere lies outside the camera frustum are not drawn
+  void setFrustumCullingEnabled(bool enabled) { frustumCullingEnabled = enabled; }
+  bool isFrustumCullingEnabled() const { return frustumCullingEnabled; }
+
+  // Objects hidden behind the previous frame's depth are not drawn, GpuCulled mode only
+  void setOcclusionCullingEnabled(bool enabled) { occlusionCullingEnabled = enabled; }
+  bool isOcclusionCullingEnabled() const { return occlusionCullingEnabled; }
+
+  // Objects are drawn roughly front to back, grouped by model within each doubling of view depth,
+  // so the depth test rejects more occluded fragments before they are shaded. Off, only objects
+  // sharing a model are drawn front to back, which minimizes binds.
+  void setFrontToBackEnabled(bool enabled) { frontToBackEnabled = enabled; }
+  bool isFrontToBackEnabled() const { return frontToBackEnabled; }
+
+  // PerObject mode, and the per object fallback, first lays down depth without shading, then
+  // shades with depth writes off and a less or equal depth test, so each pixel is shaded about
+  // once. Starts once both of its pipelines have been built.
+  void setDepthPrepassEnabled(bool enabled) { depthPrepassEnabled = enabled; }
+  bool isDepthPrepassEnabled() const { return depthPrepassEnabled; }
+
+  // Frustum culling runs as jobs on jobSystem when one is set, pass nullptr to cull on the calling
+  // thread again
+  void setJobSystem(LveJobSystem *jobSystem) { this->jobSystem = jobSystem; }
+
+  // PerObject mode splits the visible objects into one range per recording thread of renderer and
+  // records each range into a secondary command buffer as a job. Needs a job system, pass nullptr
+  // to record inline again.
+  void setParallelRecording(LveRenderer *renderer) { recordingRenderer = renderer; }
+
+  // How the swap chain render pass has to be begun for the next call to renderGameObjects
+  VkSubpassContents getSubpassContents() const {
+    return useParallelRecording() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                  : VK_SUBPASS_CONTENTS_INLINE;
+  }
 
  private:
+  // smaller frames are spread over fewer threads, each secondary command buffer has a fixed cost
+  static constexpr size_t MIN_OBJECTS_PER_RECORDING_THREAD = 256;
+  static constexpr size_t OBJECTS_PER_CULL_JOB = 1024;
+
+  struct InstanceData {
+    glm::mat4 modelMatrix{1.f};
+    glm::mat4 normalMatrix{1.f};
+  };
+
+  struct GpuBatch {
+    LveModel *model;
+    uint32_t firstInstance;
+    uint32_t objectCount;
+  };
+
   void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createPipeline(VkRenderPass renderPass);
+  void createPipeline(VkRenderPass renderPass, LvePipelineBuilder &pipelineBuilder);
+  void cullGameObjects(FrameInfo &frameInfo);
+  void sortGameObjects(FrameInfo &frameInfo);
+  void renderGameObjectsPerObject(FrameInfo &frameInfo);
+  void renderGameObjectsParallel(FrameInfo &frameInfo);
+  void recordGameObjectsInline(FrameInfo &frameInfo);
+  void recordGameObjects(
+      FrameInfo &frameInfo,
+      VkCommandBuffer commandBuffer,
+      LvePipeline &pipeline,
+      const uint32_t *slots,
+      size_t count);
+  bool useDepthPrepass() const {
+    return depthPrepassEnabled && depthPrepassPipeline->isReady() &&
+           prepassShadingPipeline->isReady();
+  }
+  bool useParallelRecording() const {
+    return renderMode == RenderMode::PerObject && recordingRenderer != nullptr &&
+           jobSystem != nullptr;
+  }
+  void renderGameObjectsInstanced(FrameInfo &frameInfo);
+  void renderGameObjectsIndirect(FrameInfo &frameInfo);
+  void renderGameObjectsGpuCulled(FrameInfo &frameInfo);
+  bool useGpuCulling() const;
+  bool isInstancedPipelineReady() const { return instancedPipeline->isReady(); }
+  void writeGpuBatches(FrameInfo &frameInfo);
+  void bindModel(LveModel &model, VkCommandBuffer commandBuffer, LveGeometryPool *&boundPool);
+  LveBuffer *writeInstanceBatches(FrameInfo &frameInfo);
+  void bindInstancedPipeline(FrameInfo &frameInfo, LveBuffer &instanceBuffer);
 
   LveDevice &lveDevice;
 
-  std::unique_ptr<LvePipeline> lvePipeline;
+  std::shared_ptr<LvePipeline> lvePipeline;
+  std::shared_ptr<LveAsyncPipeline> instancedPipeline;
+  std::shared_ptr<LveAsyncPipeline> depthPrepassPipeline;
+  std::shared_ptr<LveAsyncPipeline> prepassShadingPipeline;
+  LvePipelineBuilder *pipelineBuilder;  // builds still reference pipelineLayout
   VkPipelineLayout pipelineLayout;
+  uint32_t framesInFlight;
+
+  RenderMode renderMode{RenderMode::Indirect};
+  bool frustumCullingEnabled{true};
+  bool occlusionCullingEnabled{true};
+  bool frontToBackEnabled{true};
+  bool depthPrepassEnabled{false};
+
+  // game object map slots, rebuilt every frame by cullGameObjects
+  std::vector<uint32_t> visibleSlots;
+  LveSphereBatch boundingSpheres;
+  std::vector<uint8_t> sphereVisibility;
+  // orders visibleSlots by state and view depth, after culling
+  LveRenderQueue renderQueue;
+
+  LveJobSystem *jobSystem = nullptr;
+  LveRenderer *recordingRenderer = nullptr;
+  std::vector<VkCommandBuffer> secondaryCommandBuffers;
+
+  std::vector<std::unique_ptr<LveBuffer>> instanceBuffers;
+  std::vector<std::unique_ptr<LveBuffer>> indirectBuffers;
+  std::unordered_map<LveModel *, std::vector<InstanceData>> instanceBatches;
+  std::vector<std::pair<LveGeometryPool *, VkDrawIndexedIndirectCommand>> indirectDraws;
+
+  // GpuCulled mode, the batches are rebuilt every frame by beforeRenderPass
+  std::unique_ptr<GpuCullingSystem> gpuCullingSystem;
+  std::vector<GpuBatch> gpuBatches;
+  std::unordered_map<LveModel *, uint32_t> gpuBatchIndices;
+
+  // one row per game object slot, uploaded incrementally: a row is rewritten in a frame's buffer
+  // only when its version is newer than the version that buffer was last synced to
+  std::vector<GpuCullingSystem::ObjectData> gpuObjects;
+  std::vector<uint64_t> gpuObjectVersions;
+  std::vector<uint64_t> gpuObjectBufferVersions;
+  uint64_t gpuObjectVersion{0};
+  uint64_t gpuMatrixGeneration{0};
+  std::vector<GpuCullingSystem::DrawCommand> gpuDrawCommands;
+  std::vector<std::unique_ptr<LveBuffer>> gpuObjectBuffers;
+  std::vector<std::unique_ptr<LveBuffer>> gpuDrawCommandBuffers;
+  std::vector<std::unique_ptr<LveBuffer>> gpuInstanceBuffers;
+  bool gpuCullRecorded{false};
 };
 }  // namespace lve